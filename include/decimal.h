@@ -17,8 +17,11 @@
 #include <cstdio>
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
 #include <sstream>
 #include <math.h>
+#include <vector>
+#include <algorithm>
 
 using std::string;
 // ----------------------------------------------------------------------------
@@ -47,8 +50,10 @@ namespace dec
     // Config section
     // ----------------------------------------------------------------------------
     // - define DEC_EXTERNAL_INT64 if you do not want internal definition of "int64" data type
-    //   in this case define "DEC_INT64" somewhere
+    //   in this case define "DEC_INT64" somewhere; "DEC_UINT64" defaults to "unsigned DEC_INT64",
+    //   define it too if DEC_INT64 is not a built-in type name (e.g. a typedef)
     // - define DEC_CROSS_DOUBLE if you want to use double (intead of xdouble) for cross-conversions
+    // - define DEC_NO_INT128 if you want portable 128-bit helpers even when compiler has __int128
     
     // ----------------------------------------------------------------------------
     // Simple type definitions
@@ -58,12 +63,25 @@ namespace dec
 #ifndef DEC_EXTERNAL_INT64
 #if defined(_MSC_VER) || defined(__BORLANDC__)
     typedef signed __int64 DEC_INT64;
+    typedef unsigned __int64 DEC_UINT64;
 #else
     typedef signed long long DEC_INT64;
+    typedef unsigned long long DEC_UINT64;
 #endif
+#elif !defined(DEC_UINT64)
+#define DEC_UINT64 unsigned DEC_INT64
+#endif
+
+#if defined(__SIZEOF_INT128__) && !defined(DEC_NO_INT128)
+#define DEC_HAS_INT128
+#endif
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+#define DEC_HAS_CPP11
 #endif
     
     typedef DEC_INT64 int64;
+    typedef DEC_UINT64 uint64;
     // type for storing currency value internally
     typedef int64 dec_storage_t;
     typedef unsigned int uint;
@@ -77,7 +95,434 @@ namespace dec
     // ----------------------------------------------------------------------------
     // Constants
     // ----------------------------------------------------------------------------
+    const int64 INT64_MAX_VALUE = 0x7FFFFFFFFFFFFFFFLL;
     
+    // ----------------------------------------------------------------------------
+    // Integer helpers
+    // ----------------------------------------------------------------------------
+
+    // returns 10 ^ exponent as int64, exponent must be in range 0..18
+    inline int64 powerOfTen(int exponent) {
+        static const int64 table[19] = {
+            1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+            100000000LL, 1000000000LL, 10000000000LL, 100000000000LL,
+            1000000000000LL, 10000000000000LL, 100000000000000LL,
+            1000000000000000LL, 10000000000000000LL, 100000000000000000LL,
+            1000000000000000000LL
+        };
+        if (exponent <= 0)
+            return 1;
+        if (exponent > 18)
+            throw "Precision out of range";
+        return table[exponent];
+    }
+
+    // full 64x64 -> 128 bit unsigned multiplication, result is hi:lo
+    inline void multiply128(uint64 a, uint64 b, uint64 &hi, uint64 &lo) {
+#ifdef DEC_HAS_INT128
+        unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+        hi = static_cast<uint64>(r >> 64);
+        lo = static_cast<uint64>(r);
+#else
+        uint64 aLo = a & 0xFFFFFFFFULL, aHi = a >> 32;
+        uint64 bLo = b & 0xFFFFFFFFULL, bHi = b >> 32;
+        uint64 p0 = aLo * bLo;
+        uint64 p1 = aLo * bHi;
+        uint64 p2 = aHi * bLo;
+        uint64 p3 = aHi * bHi;
+        uint64 mid = (p0 >> 32) + (p1 & 0xFFFFFFFFULL) + (p2 & 0xFFFFFFFFULL);
+        lo = (mid << 32) | (p0 & 0xFFFFFFFFULL);
+        hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+#endif
+    }
+
+    // divides 128 bit unsigned hi:lo by divisor, quotient must fit in 64 bits (hi < divisor)
+    inline uint64 divide128(uint64 hi, uint64 lo, uint64 divisor, uint64 &remainder) {
+#ifdef DEC_HAS_INT128
+        unsigned __int128 n = (static_cast<unsigned __int128>(hi) << 64) | lo;
+        remainder = static_cast<uint64>(n % divisor);
+        return static_cast<uint64>(n / divisor);
+#else
+        uint64 quotient = 0;
+        for (int i = 63; i >= 0; i--)
+        {
+            bool carry = (hi >> 63) != 0;
+            hi = (hi << 1) | (lo >> 63);
+            lo <<= 1;
+            quotient <<= 1;
+            if (carry || hi >= divisor)
+            {
+                hi -= divisor;
+                quotient |= 1;
+            }
+        }
+        remainder = hi;
+        return quotient;
+#endif
+    }
+
+    // signed 128-bit integer (two's complement), used for exact intermediate results
+    struct int128
+    {
+        uint64 hi;
+        uint64 lo;
+
+        int128() : hi(0), lo(0) {}
+        int128(int64 value) : hi(value < 0 ? ~0ULL : 0), lo(static_cast<uint64>(value)) {}
+        int128(uint64 _hi, uint64 _lo) : hi(_hi), lo(_lo) {}
+
+        bool isNegative() const { return (hi >> 63) != 0; }
+        bool isZero() const { return hi == 0 && lo == 0; }
+        bool fitsInt64() const { return hi == ((lo >> 63) ? ~0ULL : 0); }
+
+        int64 toInt64() const
+        {
+            if (!fitsInt64())
+                throw "Value out of range";
+            return static_cast<int64>(lo);
+        }
+
+        int128 operator-() const
+        {
+            int128 result(~hi, ~lo + 1);
+            if (result.lo == 0)
+                result.hi++;
+            return result;
+        }
+
+        int128 &operator+=(const int128 &rhs)
+        {
+            uint64 old = lo;
+            lo += rhs.lo;
+            hi += rhs.hi + (lo < old ? 1 : 0);
+            return *this;
+        }
+
+        int128 &operator-=(const int128 &rhs)
+        {
+            uint64 old = lo;
+            lo -= rhs.lo;
+            hi -= rhs.hi + (old < rhs.lo ? 1 : 0);
+            return *this;
+        }
+
+        bool operator==(const int128 &rhs) const { return hi == rhs.hi && lo == rhs.lo; }
+        bool operator!=(const int128 &rhs) const { return !(*this == rhs); }
+        bool operator<(const int128 &rhs) const
+        {
+            if (hi != rhs.hi)
+                return static_cast<int64>(hi) < static_cast<int64>(rhs.hi);
+            return lo < rhs.lo;
+        }
+
+        // absolute value as unsigned hi:lo pair
+        int128 magnitude() const { return isNegative() ? -*this : *this; }
+
+        // exact product of two 64-bit values
+        static int128 multiply(int64 lhs, int64 rhs)
+        {
+            uint64 lhsAbs = lhs < 0 ? 0 - static_cast<uint64>(lhs) : static_cast<uint64>(lhs);
+            uint64 rhsAbs = rhs < 0 ? 0 - static_cast<uint64>(rhs) : static_cast<uint64>(rhs);
+            int128 result;
+            multiply128(lhsAbs, rhsAbs, result.hi, result.lo);
+            return ((lhs < 0) != (rhs < 0)) ? -result : result;
+        }
+
+        // multiplies by unsigned factor, throws on overflow
+        int128 &multiplyBy(uint64 factor)
+        {
+            bool negative = isNegative();
+            int128 value = magnitude();
+            uint64 hiOfLo, loOfLo, hiOfHi, loOfHi;
+            multiply128(value.lo, factor, hiOfLo, loOfLo);
+            multiply128(value.hi, factor, hiOfHi, loOfHi);
+            uint64 newHi = loOfHi + hiOfLo;
+            if (hiOfHi != 0 || newHi < loOfHi || (newHi >> 63) != 0)
+                throw "Value out of range";
+            hi = newHi;
+            lo = loOfLo;
+            if (negative)
+                *this = -*this;
+            return *this;
+        }
+
+        // divides magnitude by divisor (truncating), sign is kept, returns remainder of magnitude
+        uint64 divideBy(uint64 divisor)
+        {
+            bool negative = isNegative();
+            int128 value = magnitude();
+            uint64 remainder;
+            hi = value.hi / divisor;
+            lo = divide128(value.hi % divisor, value.lo, divisor, remainder);
+            if (negative)
+                *this = -*this;
+            return remainder;
+        }
+    };
+
+    // divides value by divisor rounding to nearest, ties to even (BANKERS)
+    inline int128 divideRounded(const int128 &value, uint64 divisor, RoundingType roundingType)
+    {
+        if (value.hi == 0)
+        {
+            // non-negative value below 2 ^ 64: plain 64-bit division
+            uint64 quotient = value.lo / divisor;
+            uint64 remainder = value.lo % divisor;
+            if (remainder > divisor - remainder || (remainder == divisor - remainder && (quotient & 1) != 0))
+                quotient++;
+            return int128(0ULL, quotient);
+        }
+        int128 result = value;
+        uint64 remainder = result.divideBy(divisor);
+        bool isOdd = (result.lo & 1) != 0;
+        if (remainder > divisor - remainder || (remainder == divisor - remainder && isOdd))
+            result += value.isNegative() ? int128(-1) : int128(1);
+        return result;
+    }
+
+    // value += addend, throws instead of wrapping
+    inline void addChecked(int128 &value, const int128 &addend)
+    {
+        bool negative = value.isNegative();
+        value += addend;
+        if (negative == addend.isNegative() && value.isNegative() != negative)
+            throw "Value out of range";
+    }
+
+    // value -= subtrahend, throws instead of wrapping
+    inline void subtractChecked(int128 &value, const int128 &subtrahend)
+    {
+        bool negative = value.isNegative();
+        value -= subtrahend;
+        if (negative != subtrahend.isNegative() && value.isNegative() != negative)
+            throw "Value out of range";
+    }
+
+    // wrapping (modulo 2 ^ 128) product, exact when result fits in int128
+    inline int128 multiplyWrapped(const int128 &lhs, const int128 &rhs)
+    {
+        int128 result;
+        multiply128(lhs.lo, rhs.lo, result.hi, result.lo);
+        result.hi += lhs.hi * rhs.lo + lhs.lo * rhs.hi;
+        return result;
+    }
+
+    // divides non-negative numerator by positive denominator (truncating)
+    inline int128 divideUnsigned(const int128 &numerator, const int128 &denominator, int128 &remainder)
+    {
+        if (denominator.hi == 0)
+        {
+            int128 quotient = numerator;
+            remainder = int128(0ULL, quotient.divideBy(denominator.lo));
+            return quotient;
+        }
+
+        // shift-subtract long division, only used for divisors wider than 64 bits
+        int128 quotient;
+        remainder = int128();
+        for (int bit = 127; bit >= 0; bit--)
+        {
+            uint64 next = bit >= 64 ? (numerator.hi >> (bit - 64)) & 1 : (numerator.lo >> bit) & 1;
+            remainder.hi = (remainder.hi << 1) | (remainder.lo >> 63);
+            remainder.lo = (remainder.lo << 1) | next;
+            if (remainder.hi > denominator.hi || (remainder.hi == denominator.hi && remainder.lo >= denominator.lo))
+            {
+                remainder -= denominator;
+                if (bit >= 64)
+                    quotient.hi |= 1ULL << (bit - 64);
+                else
+                    quotient.lo |= 1ULL << bit;
+            }
+        }
+        return quotient;
+    }
+
+    // divides value by positive 128-bit divisor rounding to nearest, ties to even (BANKERS)
+    inline int128 divideRounded(const int128 &value, const int128 &divisor, RoundingType roundingType)
+    {
+        int128 remainder;
+        int128 result = divideUnsigned(value.magnitude(), divisor, remainder);
+        int128 rest = divisor;
+        rest -= remainder;
+        if (rest < remainder || (rest == remainder && (result.lo & 1) != 0))
+            result += int128(1);
+        return value.isNegative() ? -result : result;
+    }
+
+    // converts value stored with precisionIn to precisionOut, rounding when precision is reduced;
+    // precision difference is not limited to 18 digits, scaling up throws on overflow
+    inline int128 rescale(const int128 &value, int precisionIn, int precisionOut, RoundingType roundingType)
+    {
+        int128 result = value;
+        for (int scale = precisionOut - precisionIn; scale > 0; scale -= 18)
+            result.multiplyBy(static_cast<uint64>(powerOfTen(scale < 18 ? scale : 18)));
+
+        int scale = precisionIn - precisionOut;
+        if (scale > 38)
+            result = int128(); // any int128 is below 10 ^ 39 / 2, so it rounds to zero
+        else if (scale > 18)
+        {
+            int128 divisor(1);
+            for (; scale > 0; scale -= 18)
+                divisor.multiplyBy(static_cast<uint64>(powerOfTen(scale < 18 ? scale : 18)));
+            result = divideRounded(value, divisor, roundingType);
+        }
+        else if (scale > 0)
+            result = divideRounded(value, static_cast<uint64>(powerOfTen(scale)), roundingType);
+        return result;
+    }
+
+    // returns square root of numerator / denominator rounded to nearest, ties to even (BANKERS)
+    inline int64 squareRootRounded(const int128 &numerator, const int128 &denominator, RoundingType roundingType)
+    {
+        if (numerator.isNegative())
+            throw "Square root of negative value";
+
+        int128 remainder;
+        int128 radicand = divideUnsigned(numerator, denominator, remainder);
+        if (radicand.hi >= (1ULL << 62))
+            throw "Value out of range";
+
+        // floor(sqrt(radicand)) with Newton iterations, starting from estimate above the root
+        uint64 root = 0;
+        if (!radicand.isZero())
+        {
+            double estimate = ::sqrt(static_cast<double>(radicand.hi) * 18446744073709551616.0
+                                     + static_cast<double>(radicand.lo));
+            root = static_cast<uint64>(estimate * (1.0 + 1e-12)) + 2;
+            for (;;)
+            {
+                uint64 rest;
+                uint64 quotient = divide128(radicand.hi, radicand.lo, root, rest);
+                uint64 next = (root >> 1) + (quotient >> 1) + (root & quotient & 1);
+                if (next >= root)
+                    break;
+                root = next;
+            }
+        }
+
+        // round up when numerator / denominator >= (root + 1/2) ^ 2, i.e. 4 * rest >= denominator
+        int128 square;
+        multiply128(root, root, square.hi, square.lo);
+        square += int128(0ULL, root);
+        int128 rest = numerator;
+        rest -= multiplyWrapped(denominator, square);
+        if (!rest.isNegative())
+        {
+            rest.multiplyBy(4);
+            if (denominator < rest || (rest == denominator && (root & 1) != 0))
+                root++;
+        }
+        return int128(0ULL, root).toInt64();
+    }
+
+    // ----------------------------------------------------------------------------
+    // Floating-point conversion helpers
+    // ----------------------------------------------------------------------------
+
+    // returns value * 10 ^ precision rounded to nearest integer, ties to even (BANKERS).
+    // Rounding is applied to the exact binary value of the double, so 2.675 (stored as
+    // 2.67499999999999982...) gives 267 at precision 2, consistent with 35.555 -> 35.55.
+    // Use shortestDecimal() first when the double stands for a decimal literal.
+    inline int64 doubleToUnbiased(double value, int precision, RoundingType roundingType)
+    {
+        uint64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        bool negative = (bits >> 63) != 0;
+        int biasedExponent = static_cast<int>((bits >> 52) & 0x7FF);
+        uint64 mantissa = bits & 0xFFFFFFFFFFFFFULL;
+
+        if (biasedExponent == 0x7FF)
+            throw "Value is not a finite number";
+        if (biasedExponent == 0)
+            biasedExponent = 1;
+        else
+            mantissa |= 1ULL << 52;
+
+        // value = mantissa * 2 ^ exponent, scaled = mantissa * 10 ^ precision (at most 113 bits)
+        int exponent = biasedExponent - 1075;
+        int128 scaled;
+        multiply128(mantissa, static_cast<uint64>(powerOfTen(precision)), scaled.hi, scaled.lo);
+
+        uint64 result;
+        if (exponent >= 0)
+        {
+            if (scaled.isZero())
+                result = 0;
+            else if (scaled.hi != 0 || exponent > 62 || (scaled.lo >> (63 - exponent)) != 0)
+                throw "Value out of range";
+            else
+                result = scaled.lo << exponent;
+        }
+        else if (exponent <= -128)
+        {
+            result = 0;
+        }
+        else
+        {
+            int shift = -exponent;
+            bool halfBit, sticky;
+            if (shift < 64)
+            {
+                if ((scaled.hi >> shift) != 0)
+                    throw "Value out of range";
+                result = (scaled.lo >> shift) | (scaled.hi << (64 - shift));
+                halfBit = ((scaled.lo >> (shift - 1)) & 1) != 0;
+                sticky = shift > 1 && (scaled.lo & ((1ULL << (shift - 1)) - 1)) != 0;
+            }
+            else if (shift == 64)
+            {
+                result = scaled.hi;
+                halfBit = (scaled.lo >> 63) != 0;
+                sticky = (scaled.lo & 0x7FFFFFFFFFFFFFFFULL) != 0;
+            }
+            else
+            {
+                result = scaled.hi >> (shift - 64);
+                halfBit = ((scaled.hi >> (shift - 65)) & 1) != 0;
+                sticky = scaled.lo != 0 || (shift > 65 && (scaled.hi & ((1ULL << (shift - 65)) - 1)) != 0);
+            }
+            if (halfBit && (sticky || (result & 1) != 0))
+                result++;
+        }
+
+        if (result > static_cast<uint64>(INT64_MAX_VALUE))
+            throw "Value out of range";
+        return negative ? -static_cast<int64>(result) : static_cast<int64>(result);
+    }
+
+    // returns value / 10 ^ precision correctly rounded to nearest double
+    inline double unbiasedToDouble(int64 value, int precision)
+    {
+        const uint64 maxExactInteger = 1ULL << 53;
+        uint64 magnitude = value < 0 ? 0 - static_cast<uint64>(value) : static_cast<uint64>(value);
+
+        // both operands are exact doubles, so a single division is correctly rounded
+        if (magnitude <= maxExactInteger)
+            return static_cast<double>(value) / static_cast<double>(powerOfTen(precision));
+
+        char buffer[32];
+        sprintf(buffer, "%llde-%d", static_cast<long long>(value), precision);
+        return strtod(buffer, NULL);
+    }
+
+    // removes trailing decimal zeros from value, returns number of zeros removed
+    // uses multiplicative inverse of 5 so both divisibility test and division are multiplications
+    inline int stripTrailingZeros(uint64 &value) {
+        const uint64 inverseOfFive = 0xCCCCCCCCCCCCCCCDULL;
+        const uint64 maxMultipleOfFive = 0x3333333333333333ULL;
+        int zeros = 0;
+        while (value != 0 && (value & 1) == 0)
+        {
+            uint64 quotient = (value >> 1) * inverseOfFive;
+            if (quotient > maxMultipleOfFive)
+                break;
+            value = quotient;
+            zeros++;
+        }
+        return zeros;
+    }
+
     // ----------------------------------------------------------------------------
     // Class definitions
     // ----------------------------------------------------------------------------
@@ -173,11 +618,11 @@ namespace dec
         {
             int precisionHighest = precision;
             int precisionDiff = 0;
-            int precisionDiffFactor = 0;
+            int64 precisionDiffFactor = 0;
             dec_storage_t rhs_m_value = rhs.m_value;
             dec_storage_t lhs_m_value = m_value;
             
-            int precisionHighestFactor = precisionFactor;
+            int64 precisionHighestFactor = precisionFactor;
             precisionFunction(rhs_m_value, lhs_m_value, rhs.precision, rhs.precisionFactor , precisionHighest, precisionHighestFactor, precisionDiff, precisionDiffFactor);
 
             return (lhs_m_value == rhs_m_value);
@@ -186,11 +631,11 @@ namespace dec
         {   
             int precisionHighest = precision;
             int precisionDiff = 0;
-            int precisionDiffFactor = 0;
+            int64 precisionDiffFactor = 0;
             dec_storage_t rhs_m_value = rhs.m_value; 
             dec_storage_t lhs_m_value = m_value;
             
-            int precisionHighestFactor = precisionFactor;
+            int64 precisionHighestFactor = precisionFactor;
             precisionFunction(rhs_m_value, lhs_m_value, rhs.precision, rhs.precisionFactor , precisionHighest, precisionHighestFactor, precisionDiff, precisionDiffFactor);
             
             return (lhs_m_value < rhs_m_value);
@@ -200,11 +645,11 @@ namespace dec
         {
             int precisionHighest = precision;
             int precisionDiff = 0;
-            int precisionDiffFactor = 0;
+            int64 precisionDiffFactor = 0;
             dec_storage_t rhs_m_value = rhs.m_value; 
             dec_storage_t lhs_m_value = m_value;
             
-            int precisionHighestFactor = precisionFactor;
+            int64 precisionHighestFactor = precisionFactor;
             precisionFunction(rhs_m_value, lhs_m_value, rhs.precision, rhs.precisionFactor , precisionHighest, precisionHighestFactor, precisionDiff, precisionDiffFactor);
 
             return (lhs_m_value <= rhs_m_value);
@@ -214,11 +659,11 @@ namespace dec
         {
             int precisionHighest = precision;
             int precisionDiff = 0;
-            int precisionDiffFactor = 0;
+            int64 precisionDiffFactor = 0;
             dec_storage_t rhs_m_value = rhs.m_value; 
             dec_storage_t lhs_m_value = m_value;
 
-            int precisionHighestFactor = precisionFactor;
+            int64 precisionHighestFactor = precisionFactor;
             precisionFunction(rhs_m_value, lhs_m_value, rhs.precision, rhs.precisionFactor , precisionHighest, precisionHighestFactor, precisionDiff, precisionDiffFactor);
 
             return (lhs_m_value > rhs_m_value);
@@ -229,11 +674,11 @@ namespace dec
              
             int precisionHighest = precision;
             int precisionDiff = 0;
-            int precisionDiffFactor = 0;
+            int64 precisionDiffFactor = 0;
             dec_storage_t rhs_m_value = rhs.m_value; 
             dec_storage_t lhs_m_value = m_value;  
 
-            int precisionHighestFactor = precisionFactor;
+            int64 precisionHighestFactor = precisionFactor;
             precisionFunction(rhs_m_value, lhs_m_value, rhs.precision, rhs.precisionFactor , precisionHighest, precisionHighestFactor, precisionDiff, precisionDiffFactor);
 
             return (lhs_m_value >= rhs_m_value);
@@ -245,9 +690,9 @@ namespace dec
         }
         
         void precisionFunction(dec_storage_t &rhs_m_value, dec_storage_t &lhs_m_value, 
-                                int rhs_precision, int rhs_precisionFactor,
-                                int &precisionHighest, int &precisionHighestFactor,
-                                int precisionDiff, int precisionDiffFactor) const
+                                int rhs_precision, int64 rhs_precisionFactor,
+                                int &precisionHighest, int64 &precisionHighestFactor,
+                                int precisionDiff, int64 precisionDiffFactor) const
         {
             if (precision > rhs_precision) 
             {
@@ -265,7 +710,7 @@ namespace dec
             }
         }
 
-        void precisionFunction2(dec_storage_t &rhs_m_value, const int precisionOut, int precisionHighest, int precisionDiff, int precisionDiffFactor)
+        void precisionFunction2(dec_storage_t &rhs_m_value, const int precisionOut, int precisionHighest, int precisionDiff, int64 precisionDiffFactor)
         {
             precision = precisionOut;
             precisionFactor = getPrecisionFactor(precision);     
@@ -290,8 +735,15 @@ namespace dec
         
         void add(int rhs, const int precisionOut, RoundingType roundingType) 
         {
-            decimal x( rhs, precisionOut);
-            this->add(x, precisionOut, roundingType);
+            this->add(static_cast<int64>(rhs), precisionOut, roundingType);
+        }
+        
+        // integer fast path: exact 128-bit sum, single rounding to precisionOut
+        void add(int64 rhs, const int precisionOut, RoundingType roundingType) 
+        {
+            int128 result(m_value);
+            result += int128::multiply(rhs, powerOfTen(precision));
+            setWide(result, precision, precisionOut, roundingType);
         }
         
         void add(double rhs, const int precisionOut, RoundingType roundingType) 
@@ -311,10 +763,10 @@ namespace dec
 
             int precisionHighest = precision;
             int precisionDiff = 0;
-            int precisionDiffFactor = 0;
+            int64 precisionDiffFactor = 0;
             dec_storage_t rhs_m_value = rhs.m_value; 
             
-            int precisionHighestFactor = precisionFactor;
+            int64 precisionHighestFactor = precisionFactor;
             precisionFunction(rhs_m_value, m_value, rhs.precision, rhs.precisionFactor , precisionHighest, precisionHighestFactor, precisionDiff, precisionDiffFactor);
             
             m_value += rhs_m_value;
@@ -332,8 +784,14 @@ namespace dec
         
         void subtract(int rhs, const int precisionOut, RoundingType roundingType) 
         {
-            decimal x( rhs, precisionOut);
-            this->subtract(x, precisionOut, roundingType);
+            this->subtract(static_cast<int64>(rhs), precisionOut, roundingType);
+        }
+        
+        void subtract(int64 rhs, const int precisionOut, RoundingType roundingType) 
+        {
+            int128 result(m_value);
+            result -= int128::multiply(rhs, powerOfTen(precision));
+            setWide(result, precision, precisionOut, roundingType);
         }
         
         void subtract(double rhs, const int precisionOut, RoundingType roundingType) 
@@ -353,9 +811,9 @@ namespace dec
 
             int precisionHighest = precision;
             int precisionDiff = 0;
-            int precisionDiffFactor = 0;
+            int64 precisionDiffFactor = 0;
             dec_storage_t rhs_m_value = rhs.m_value; 
-            int precisionHighestFactor = precisionFactor;
+            int64 precisionHighestFactor = precisionFactor;
             precisionFunction(rhs_m_value, m_value, rhs.precision, rhs.precisionFactor , precisionHighest, precisionHighestFactor, precisionDiff, precisionDiffFactor);
 
             m_value -= rhs_m_value;
@@ -373,8 +831,13 @@ namespace dec
         
         void multiply(int rhs, const int precisionOut, RoundingType roundingType) 
         {
-            decimal x( rhs, precisionOut);
-            this->multiply(x, precisionOut, roundingType);
+            this->multiply(static_cast<int64>(rhs), precisionOut, roundingType);
+        }
+        
+        // integer fast path: exact 128-bit product, single rounding to precisionOut
+        void multiply(int64 rhs, const int precisionOut, RoundingType roundingType) 
+        {
+            setWide(int128::multiply(m_value, rhs), precision, precisionOut, roundingType);
         }
         
         void multiply(double rhs, const int precisionOut, RoundingType roundingType) 
@@ -391,10 +854,10 @@ namespace dec
         
         void multiply(const decimal &rhs, const int precisionOut, RoundingType roundingType) 
         {
-            int precisionHighestFactor = precisionFactor;
+            int64 precisionHighestFactor = precisionFactor;
             int precisionHighest = precision;
             int precisionDiff = 0;
-            int precisionDiffFactor = 0;
+            int64 precisionDiffFactor = 0;
             dec_storage_t rhs_m_value = rhs.m_value; 
             
             precisionFunction(rhs_m_value, m_value, rhs.precision, rhs.precisionFactor , precisionHighest, precisionHighestFactor, precisionDiff, precisionDiffFactor);
@@ -416,6 +879,13 @@ namespace dec
             return result;
         }
 
+        static const decimal multiply(const decimal &lhs, const int64 &rhs, const int precisionOut, RoundingType roundingType)  
+        {
+            decimal result = lhs;
+            result.multiply( rhs, precisionOut, roundingType);
+            return result;
+        }
+
         static const decimal multiply(const decimal &lhs, const double &rhs, const int precisionOut, RoundingType roundingType)  
         {
             decimal result = lhs;
@@ -438,13 +908,35 @@ namespace dec
         }
         
         void divide(int rhs, const int precisionOut, RoundingType roundingType) 
+        {
+            this->divide(static_cast<int64>(rhs), precisionOut, roundingType);
+        }
+        
+        // integer fast path: single integer division rounded to precisionOut
+        void divide(int64 rhs, const int precisionOut, RoundingType roundingType) 
         {
             if(rhs == 0){           
                 throw "It's not possible to divide by cero";
             }
-            else{       
-                decimal x( rhs, precisionOut);
-                this->divide(x, precisionOut, roundingType);
+            else{
+                int128 result(m_value);
+                if (rhs < 0)
+                    result = -result;
+                uint64 divisor = rhs < 0 ? 0 - static_cast<uint64>(rhs) : static_cast<uint64>(rhs);
+                if (precisionOut > precision)
+                {
+                    result.multiplyBy(static_cast<uint64>(powerOfTen(precisionOut - precision)));
+                }
+                else if (precisionOut < precision)
+                {
+                    uint64 hi, lo;
+                    multiply128(divisor, static_cast<uint64>(powerOfTen(precision - precisionOut)), hi, lo);
+                    // divisor larger than any stored value gives zero
+                    if (hi != 0)
+                        result = int128();
+                    divisor = hi != 0 ? 1 : lo;
+                }
+                setWide(divideRounded(result, divisor, roundingType), precisionOut, precisionOut, roundingType);
             }
         }
         
@@ -472,11 +964,11 @@ namespace dec
         
         void divide(const decimal &rhs, const int precisionOut, RoundingType roundingType) 
         {
-            int precisionHighestFactor = precisionFactor;
+            int64 precisionHighestFactor = precisionFactor;
             
             int precisionHighest = precision;
             int precisionDiff = 0;
-            int precisionDiffFactor = 0;
+            int64 precisionDiffFactor = 0;
             dec_storage_t rhs_m_value = rhs.m_value; 
             
             if(&rhs == 0){
@@ -497,6 +989,26 @@ namespace dec
             }
         }
         
+        static const decimal divide(const decimal &lhs, const int64 &rhs, const int precisionOut, RoundingType roundingType)  
+        {
+            decimal result = lhs;
+            result.divide(rhs, precisionOut, roundingType);
+            return result;
+        }
+        
+        // multiplies value by 10 ^ places (places can be negative, e.g. -4 for basis points)
+        void shiftDecimal(int places, const int precisionOut, RoundingType roundingType) 
+        {
+            setWide(int128(m_value), precision - places, precisionOut, roundingType);
+        }
+        
+        static const decimal shiftDecimal(const decimal &lhs, int places, const int precisionOut, RoundingType roundingType)  
+        {
+            decimal result = lhs;
+            result.shiftDecimal(places, precisionOut, roundingType);
+            return result;
+        }
+        
         static const decimal divide(const decimal &lhs, const decimal &rhs, const int precisionOut, RoundingType roundingType)  
         {
             if(&lhs == 0){
@@ -511,7 +1023,7 @@ namespace dec
         
         double getAsDouble() const 
         { 
-            return static_cast<double>(m_value) / static_cast<double>(precisionFactor); 
+            return unbiasedToDouble(m_value, precision); 
         }
         
         
@@ -524,6 +1036,22 @@ namespace dec
         // use to load/store decimal value in external memory
         int64 getUnbiased() const { return m_value; }
         void setUnbiased(int64 value) { m_value = value; }
+
+        // returns hash consistent with operator==, so 1.5 (precision 1) and 1.50 (precision 2)
+        // give the same result - value is normalized by stripping trailing zeros
+        size_t hash() const
+        {
+            uint64 magnitude = m_value < 0 ? 0 - static_cast<uint64>(m_value) : static_cast<uint64>(m_value);
+            int exponent = magnitude == 0 ? 0 : precision - stripTrailingZeros(magnitude);
+            uint64 key = m_value < 0 ? 0 - magnitude : magnitude;
+
+            // splitmix64 finalizer
+            key ^= static_cast<uint64>(exponent) * 0x9E3779B97F4A7C15ULL;
+            key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+            key ^= key >> 31;
+            return static_cast<size_t>(key);
+        }
         
         //untested
         decimal abs(RoundingType roundingType) const 
@@ -534,12 +1062,28 @@ namespace dec
                 return (subtract(decimal(0,precision), *this, precision, roundingType));
         }
         
+        // returns square root with precisionOut digits, correctly rounded
+        decimal sqrt(const int precisionOut, RoundingType roundingType) const
+        {
+            int128 numerator(m_value);
+            int128 denominator(1);
+            int exponent = 2 * precisionOut - precision;
+            if (exponent < 0)
+                denominator = int128(powerOfTen(-exponent));
+            for (; exponent > 0; exponent -= 18)
+                numerator.multiplyBy(static_cast<uint64>(powerOfTen(exponent < 18 ? exponent : 18)));
+
+            decimal result(0, precisionOut);
+            result.setUnbiased(squareRootRounded(numerator, denominator, roundingType));
+            return result;
+        }
+        
         int64 getAsInteger(RoundingType roundingType) const 
         {
             return round(getAsXDouble());
         }
         
-        string toString()
+        string toString() const
         {
             dec_storage_t tempValue = m_value;
             int precisionTemp = precision;
@@ -594,6 +1138,14 @@ namespace dec
         
     protected:
         
+        // stores value given with valuePrecision digits as precisionOut digits, rounding once
+        void setWide(const int128 &value, int valuePrecision, const int precisionOut, RoundingType roundingType)
+        {
+            m_value = rescale(value, valuePrecision, precisionOut, roundingType).toInt64();
+            precision = precisionOut;
+            precisionFactor = getPrecisionFactor(precision);
+        }
+        
         void init(const decimal &src) 
         { 
             m_value = src.m_value; 
@@ -637,41 +1189,275 @@ namespace dec
         {
             precision = _precision;
             precisionFactor = getPrecisionFactor(precision);
-            m_value =
-            round(
-                  static_cast<double>(precisionFactor) *
-                  value
-                  );
+            m_value = doubleToUnbiased(value, precision, roundingType);
         }
         
         void init(float value, int _precision, RoundingType roundingType) 
         {
             precision = _precision;
             precisionFactor = getPrecisionFactor(precision);
-            m_value =
-            round(
-                  static_cast<double>(precisionFactor) *
-                  static_cast<double>(value)
-                  );
+            m_value = doubleToUnbiased(static_cast<double>(value), precision, roundingType);
         }
 
     protected:
         dec_storage_t m_value;
         int precision;
-        int precisionFactor;
+        int64 precisionFactor;
         
-        static int getPrecisionFactor(int prec)
+        static int64 getPrecisionFactor(int prec)
+        {
+            return powerOfTen(prec);
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // Allocation
+    // ----------------------------------------------------------------------------
+
+    // orders allocation remainders: largest first, lower index first on ties
+    struct AllocationOrder
+    {
+        bool operator()(const std::pair<uint64, size_t> &lhs, const std::pair<uint64, size_t> &rhs) const
+        {
+            if (lhs.first != rhs.first)
+                return lhs.first > rhs.first;
+            return lhs.second < rhs.second;
+        }
+    };
+
+    // Splits total into count shares proportional to weights (largest remainder method).
+    // Shares are stored in out with precision of total and always sum up exactly to total.
+    // Leftover units go to entries with largest remainders, ties go to lower index.
+    // Weights must be non-negative and their sum must be positive and fit in int64.
+    inline void allocate(const decimal &total, const int64 *weights, size_t count, decimal *out)
+    {
+        if (count == 0)
+            throw "Nothing to allocate to";
+
+        int64 weightSum = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (weights[i] < 0)
+                throw "Allocation weight can not be negative";
+            if (weights[i] > INT64_MAX_VALUE - weightSum)
+                throw "Allocation weights overflow";
+            weightSum += weights[i];
+        }
+        if (weightSum == 0)
+            throw "Allocation weights sum up to zero";
+
+        int64 totalValue = total.getUnbiased();
+        bool isNegative = totalValue < 0;
+        uint64 amount = isNegative ? 0 - static_cast<uint64>(totalValue) : static_cast<uint64>(totalValue);
+        uint64 divisor = static_cast<uint64>(weightSum);
+
+        // (remainder, index) pairs of entries which may still receive a unit
+        std::vector< std::pair<uint64, size_t> > remainders;
+        remainders.reserve(count);
+
+        uint64 allocated = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64 hi, lo, remainder;
+            multiply128(amount, static_cast<uint64>(weights[i]), hi, lo);
+            uint64 share = divide128(hi, lo, divisor, remainder);
+            allocated += share;
+            out[i] = decimal(0, total.getPrecision());
+            out[i].setUnbiased(static_cast<int64>(share));
+            if (remainder != 0)
+                remainders.push_back(std::make_pair(remainder, i));
+        }
+
+        // leftover is always smaller than number of non-zero remainders
+        size_t leftover = static_cast<size_t>(amount - allocated);
+        if (leftover > 0)
+        {
+            std::nth_element(remainders.begin(), remainders.begin() + (leftover - 1), remainders.end(),
+                             AllocationOrder());
+            for (size_t i = 0; i < leftover; i++)
+            {
+                decimal &share = out[remainders[i].second];
+                share.setUnbiased(share.getUnbiased() + 1);
+            }
+        }
+
+        if (isNegative)
         {
-            if(prec <= 0 )
-                return 1;
-            else if (prec == 1)
-                return 10;
+            for (size_t i = 0; i < count; i++)
+                out[i].setUnbiased(-out[i].getUnbiased());
+        }
+    }
+
+    // Splits total by decimal weights, weights are rescaled to the highest precision used.
+    inline void allocate(const decimal &total, const decimal *weights, size_t count, decimal *out)
+    {
+        int precisionHighest = 0;
+        for (size_t i = 0; i < count; i++)
+            if (weights[i].getPrecision() > precisionHighest)
+                precisionHighest = weights[i].getPrecision();
+
+        std::vector<int64> scaled(count);
+        for (size_t i = 0; i < count; i++)
+            scaled[i] = rescale(int128(weights[i].getUnbiased()), weights[i].getPrecision(),
+                                precisionHighest, BANKERS).toInt64();
+
+        allocate(total, count ? &scaled[0] : 0, count, out);
+    }
+
+    // ----------------------------------------------------------------------------
+    // Conversion
+    // ----------------------------------------------------------------------------
+
+    // returns decimal with the lowest precision (up to maxPrecision) which converts
+    // back to exactly the same double, e.g. 0.1 gives 0.1 with precision 1
+    inline decimal shortestDecimal(double value, int maxPrecision, RoundingType roundingType)
+    {
+        decimal result(0, maxPrecision);
+        for (int prec = 0; prec <= maxPrecision; prec++)
+        {
+            int64 unbiased = doubleToUnbiased(value, prec, roundingType);
+            if (unbiasedToDouble(unbiased, prec) == value || prec == maxPrecision)
+            {
+                result = decimal(0, prec);
+                result.setUnbiased(unbiased);
+                break;
+            }
+        }
+        return result;
+    }
+
+    // converts array of decimals to doubles
+    inline void toDoubles(const decimal *values, size_t count, double *out)
+    {
+        for (size_t i = 0; i < count; i++)
+            out[i] = unbiasedToDouble(values[i].getUnbiased(), values[i].getPrecision());
+    }
+
+    // converts array of doubles to decimals with given precision
+    inline void fromDoubles(const double *values, size_t count, const int precision,
+                            RoundingType roundingType, decimal *out)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            out[i] = decimal(0, precision);
+            out[i].setUnbiased(doubleToUnbiased(values[i], precision, roundingType));
+        }
+    }
+
+    // converts column of unbiased values sharing one precision to doubles
+    inline void unbiasedToDoubles(const int64 *values, size_t count, const int precision, double *out)
+    {
+        const int64 maxExactInteger = 1LL << 53;
+        const double divisor = static_cast<double>(powerOfTen(precision));
+        for (size_t i = 0; i < count; i++)
+        {
+            if (values[i] <= maxExactInteger && values[i] >= -maxExactInteger)
+                out[i] = static_cast<double>(values[i]) / divisor;
             else
-                return 10 * getPrecisionFactor(prec - 1);
+                out[i] = unbiasedToDouble(values[i], precision);
+        }
+    }
+
+    // converts doubles to column of unbiased values with given precision
+    inline void doublesToUnbiased(const double *values, size_t count, const int precision,
+                                  RoundingType roundingType, int64 *out)
+    {
+        for (size_t i = 0; i < count; i++)
+            out[i] = doubleToUnbiased(values[i], precision, roundingType);
+    }
+
+    // ----------------------------------------------------------------------------
+    // Accumulation
+    // ----------------------------------------------------------------------------
+
+    // Sums decimals exactly in 128-bit integer using the highest precision seen so far.
+    // Rounding is applied only once, when the result is read with getValue(), so the
+    // result does not depend on the order of accumulation.
+    //
+    // Sample usage:
+    //   decimal_accumulator total;
+    //   for (size_t i = 0; i < count; i++)
+    //       total.add(amounts[i]);
+    //   decimal result = total.getValue(2, BANKERS);
+    class decimal_accumulator
+    {
+    public:
+        decimal_accumulator() : m_precision(0) {}
+
+        inline int getPrecision() const { return m_precision; }
+
+        void reset()
+        {
+            m_sum = int128();
+            m_precision = 0;
+        }
+
+        void add(const decimal &value)
+        {
+            addChecked(m_sum, widen(value));
+        }
+
+        void subtract(const decimal &value)
+        {
+            subtractChecked(m_sum, widen(value));
+        }
+
+        void add(const decimal_accumulator &other)
+        {
+            if (other.m_precision > m_precision)
+                raisePrecision(other.m_precision);
+            addChecked(m_sum, rescale(other.m_sum, other.m_precision, m_precision, BANKERS));
+        }
+
+        // returns exact sum stored with getPrecision() digits
+        const int128 &getUnbiased() const { return m_sum; }
+
+        decimal getValue(const int precisionOut, RoundingType roundingType) const
+        {
+            decimal result(0, precisionOut);
+            result.setUnbiased(rescale(m_sum, m_precision, precisionOut, roundingType).toInt64());
+            return result;
         }
+
+    protected:
+        int128 m_sum;
+        int m_precision;
+
+        void raisePrecision(int precision)
+        {
+            m_sum.multiplyBy(static_cast<uint64>(powerOfTen(precision - m_precision)));
+            m_precision = precision;
+        }
+
+        int128 widen(const decimal &value)
+        {
+            if (value.getPrecision() > m_precision)
+                raisePrecision(value.getPrecision());
+            return int128::multiply(value.getUnbiased(), powerOfTen(m_precision - value.getPrecision()));
+        }
+    };
+
+    // hash functor, for use with hash containers
+    struct decimal_hash
+    {
+        size_t operator()(const decimal &value) const { return value.hash(); }
     };
 
     static const decimal ZERO = decimal();
     
 } // namespace
+
+#ifdef DEC_HAS_CPP11
+#include <functional>
+
+namespace std
+{
+    template<>
+    struct hash<dec::decimal>
+    {
+        size_t operator()(const dec::decimal &value) const { return value.hash(); }
+    };
+}
+#endif
+
 #endif // _DECIMAL_H__
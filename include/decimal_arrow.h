@@ -0,0 +1,245 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        decimal_arrow.h
+// Purpose:     Import / export of decimal arrays in Apache Arrow Decimal64 and
+//              Decimal128 fixed-width buffer layout.
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _DECIMAL_ARROW_H__
+#define _DECIMAL_ARROW_H__
+
+#include "decimal.h"
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file decimal_arrow.h
+///
+/// Arrow stores decimal column as fixed-width little-endian two's complement
+/// integers (8 bytes for Decimal64, 16 bytes for Decimal128) equal to
+/// value * 10 ^ scale, plus optional validity bitmap (LSB first, 1 = valid).
+/// No Arrow library is needed, only raw buffers are used.
+///
+/// Sample usage:
+///   using namespace dec;
+///   arrow_decimal_field field = arrow_decimal_field::decimal128(18, 2);
+///   std::vector<unsigned char> data(count * field.byteWidth);
+///   exportArrowDecimal(values, count, field, BANKERS, &data[0], NULL);
+///
+///   arrow_decimal_view view(&data[0], NULL, 0, count, field);
+///   decimal first = view.get(0);
+
+#if defined(_MSC_VER) || \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define DEC_LITTLE_ENDIAN
+#endif
+
+namespace dec
+{
+    // ----------------------------------------------------------------------------
+    // Arrow field metadata
+    // ----------------------------------------------------------------------------
+    struct arrow_decimal_field
+    {
+        // 8 for Decimal64, 16 for Decimal128
+        int byteWidth;
+        // maximum number of significant digits
+        int precision;
+        // number of digits after decimal point
+        int scale;
+
+        static arrow_decimal_field decimal64(int precision, int scale)
+        {
+            if (precision < 1 || precision > 18)
+                throw "Decimal64 precision must be in range 1..18";
+            return make(8, precision, scale);
+        }
+
+        static arrow_decimal_field decimal128(int precision, int scale)
+        {
+            if (precision < 1 || precision > 38)
+                throw "Decimal128 precision must be in range 1..38";
+            return make(16, precision, scale);
+        }
+
+    private:
+        static arrow_decimal_field make(int byteWidth, int precision, int scale)
+        {
+            if (scale < 0 || scale > 18)
+                throw "Unsupported decimal scale";
+            arrow_decimal_field field;
+            field.byteWidth = byteWidth;
+            field.precision = precision;
+            field.scale = scale;
+            return field;
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // Buffer helpers
+    // ----------------------------------------------------------------------------
+
+    inline bool getArrowBit(const unsigned char *bitmap, size_t index)
+    {
+        return bitmap == NULL || ((bitmap[index >> 3] >> (index & 7)) & 1) != 0;
+    }
+
+    inline void setArrowBit(unsigned char *bitmap, size_t index, bool value)
+    {
+        if (value)
+            bitmap[index >> 3] |= static_cast<unsigned char>(1 << (index & 7));
+        else
+            bitmap[index >> 3] &= static_cast<unsigned char>(~(1 << (index & 7)));
+    }
+
+    // stores value as byteWidth bytes little-endian, sign-extended
+    inline void storeArrowValue(unsigned char *slot, int byteWidth, int64 value)
+    {
+#ifdef DEC_LITTLE_ENDIAN
+        memcpy(slot, &value, 8);
+#else
+        uint64 bits = static_cast<uint64>(value);
+        for (int i = 0; i < 8; i++)
+            slot[i] = static_cast<unsigned char>(bits >> (8 * i));
+#endif
+        if (byteWidth > 8)
+            memset(slot + 8, value < 0 ? 0xFF : 0x00, byteWidth - 8);
+    }
+
+    // loads byteWidth bytes little-endian value, throws if it does not fit in int64
+    inline int64 loadArrowValue(const unsigned char *slot, int byteWidth)
+    {
+        uint64 bits;
+#ifdef DEC_LITTLE_ENDIAN
+        memcpy(&bits, slot, 8);
+#else
+        bits = 0;
+        for (int i = 0; i < 8; i++)
+            bits |= static_cast<uint64>(slot[i]) << (8 * i);
+#endif
+        unsigned char extension = (bits >> 63) ? 0xFF : 0x00;
+        for (int i = 8; i < byteWidth; i++)
+            if (slot[i] != extension)
+                throw "Value out of range";
+        return static_cast<int64>(bits);
+    }
+
+    // ----------------------------------------------------------------------------
+    // Zero-copy view
+    // ----------------------------------------------------------------------------
+
+    // Read-only view of Arrow decimal buffers, values are decoded on access
+    // without copying the buffers.
+    class arrow_decimal_view
+    {
+    public:
+        arrow_decimal_view(const unsigned char *data, const unsigned char *validity,
+                           size_t offset, size_t length, const arrow_decimal_field &field)
+        : m_data(data), m_validity(validity), m_offset(offset), m_length(length), m_field(field)
+        {}
+
+        size_t size() const { return m_length; }
+        const arrow_decimal_field &getField() const { return m_field; }
+
+        bool isValid(size_t index) const { return getArrowBit(m_validity, m_offset + index); }
+
+        // returns value * 10 ^ scale
+        int64 getUnbiased(size_t index) const
+        {
+            return loadArrowValue(m_data + (m_offset + index) * m_field.byteWidth, m_field.byteWidth);
+        }
+
+        decimal get(size_t index) const
+        {
+            decimal result(0, m_field.scale);
+            result.setUnbiased(getUnbiased(index));
+            return result;
+        }
+
+        // direct access to Decimal64 values as unbiased int64 column (little-endian hosts only),
+        // returns NULL when buffer layout is not the native one
+        const int64 *getUnbiasedColumn() const
+        {
+#ifdef DEC_LITTLE_ENDIAN
+            if (m_field.byteWidth == 8)
+                return reinterpret_cast<const int64 *>(m_data) + m_offset;
+#endif
+            return NULL;
+        }
+
+    protected:
+        const unsigned char *m_data;
+        const unsigned char *m_validity;
+        size_t m_offset;
+        size_t m_length;
+        arrow_decimal_field m_field;
+    };
+
+    // ----------------------------------------------------------------------------
+    // Import / export
+    // ----------------------------------------------------------------------------
+
+    // Writes values rescaled to field.scale into data (count * field.byteWidth bytes).
+    // When validity is not NULL all count bits are set to valid.
+    // Throws if value has more digits than field.precision.
+    inline void exportArrowDecimal(const decimal *values, size_t count, const arrow_decimal_field &field,
+                                   RoundingType roundingType, unsigned char *data, unsigned char *validity)
+    {
+        const int64 limit = field.precision < 19 ? powerOfTen(field.precision) : 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            int64 value = values[i].getUnbiased();
+            if (values[i].getPrecision() != field.scale)
+                value = rescale(int128(value), values[i].getPrecision(), field.scale, roundingType).toInt64();
+            if (limit != 0 && (value >= limit || value <= -limit))
+                throw "Value exceeds Arrow decimal precision";
+            storeArrowValue(data + i * field.byteWidth, field.byteWidth, value);
+            if (validity != NULL)
+                setArrowBit(validity, i, true);
+        }
+    }
+
+    // Writes column of unbiased values already stored with field.scale digits.
+    // For Decimal64 on little-endian hosts this is a single memcpy.
+    // Throws if value has more digits than field.precision.
+    inline void exportArrowDecimal(const int64 *unbiased, size_t count, const arrow_decimal_field &field,
+                                   unsigned char *data)
+    {
+        const int64 limit = field.precision < 19 ? powerOfTen(field.precision) : 0;
+        if (limit != 0)
+        {
+            for (size_t i = 0; i < count; i++)
+                if (unbiased[i] >= limit || unbiased[i] <= -limit)
+                    throw "Value exceeds Arrow decimal precision";
+        }
+#ifdef DEC_LITTLE_ENDIAN
+        if (field.byteWidth == 8)
+        {
+            memcpy(data, unbiased, count * sizeof(int64));
+            return;
+        }
+#endif
+        for (size_t i = 0; i < count; i++)
+            storeArrowValue(data + i * field.byteWidth, field.byteWidth, unbiased[i]);
+    }
+
+    // Reads count values starting at offset into out, using field.scale as precision.
+    // Null entries are stored as zero; isValid (optional) receives validity of each entry.
+    inline void importArrowDecimal(const unsigned char *data, const unsigned char *validity,
+                                   size_t offset, size_t count, const arrow_decimal_field &field,
+                                   decimal *out, bool *isValid)
+    {
+        arrow_decimal_view view(data, validity, offset, count, field);
+        for (size_t i = 0; i < count; i++)
+        {
+            bool valid = view.isValid(i);
+            out[i] = decimal(0, field.scale);
+            if (valid)
+                out[i].setUnbiased(view.getUnbiased(i));
+            if (isValid != NULL)
+                isValid[i] = valid;
+        }
+    }
+
+} // namespace
+#endif // _DECIMAL_ARROW_H__
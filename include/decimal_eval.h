@@ -0,0 +1,640 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        decimal_eval.h
+// Purpose:     Parallel columnar evaluation of formulas over decimal columns.
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _DECIMAL_EVAL_H__
+#define _DECIMAL_EVAL_H__
+
+#include "decimal.h"
+
+#ifndef DEC_HAS_CPP11
+#error "decimal_eval.h requires C++11"
+#endif
+
+#include <map>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file decimal_eval.h
+///
+/// Formula is built as C++ expression from named columns and constants
+/// (+, -, * and unary -). It is compiled once into a postfix program which is
+/// run chunk by chunk (chunkSize rows at a time) on a work-stealing thread pool.
+/// Intermediate values are exact 128-bit integers with precision derived from
+/// the operands (a product carries the digits of both factors, even above 18),
+/// the result is rounded once to the output precision. Intermediate values
+/// which do not fit in 128 bits (about 38 digits) throw "Value out of range".
+/// Each chunk with all precisions up to 18 is first run with 64-bit
+/// intermediates and run again with 128-bit ones only if any of them overflows.
+///
+/// Sample usage:
+///   using namespace dec;
+///   work_stealing_pool pool;
+///   columnar_evaluator evaluator(pool);
+///   evaluator.bind("qty", qty, 0);
+///   evaluator.bind("price", price, 4);
+///   evaluator.bind("fx", fx, 8);
+///   evaluator.bind("fee", fee, 2);
+///
+///   decimal_expression formula =
+///       column("qty") * column("price") * column("fx") - column("fee");
+///   evaluator.evaluate(formula, rows, 2, BANKERS, result);
+
+namespace dec
+{
+    // ----------------------------------------------------------------------------
+    // Thread pool
+    // ----------------------------------------------------------------------------
+
+    // Runs batches of indexed tasks. Each worker owns a queue with a contiguous
+    // block of tasks and takes work from its back; idle workers steal from the
+    // front of other queues.
+    class work_stealing_pool
+    {
+    public:
+        explicit work_stealing_pool(size_t threadCount = 0)
+        : m_task(NULL), m_generation(0), m_active(0), m_stop(false)
+        {
+            if (threadCount == 0)
+                threadCount = std::thread::hardware_concurrency();
+            if (threadCount == 0)
+                threadCount = 1;
+            for (size_t i = 0; i < threadCount; i++)
+                m_queues.push_back(std::unique_ptr<task_queue>(new task_queue()));
+            for (size_t i = 0; i < threadCount; i++)
+                m_threads.push_back(std::thread(&work_stealing_pool::workerLoop, this, i));
+        }
+
+        ~work_stealing_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (size_t i = 0; i < m_threads.size(); i++)
+                m_threads[i].join();
+        }
+
+        size_t getThreadCount() const { return m_threads.size(); }
+
+        // calls task(i) for i in 0..taskCount-1 and waits for completion,
+        // first exception thrown by a task is rethrown here;
+        // concurrent callers are served one batch at a time
+        void run(size_t taskCount, const std::function<void(size_t)> &task)
+        {
+            if (taskCount == 0)
+                return;
+
+            std::lock_guard<std::mutex> runLock(m_runMutex);
+            std::unique_lock<std::mutex> lock(m_mutex);
+            size_t workers = m_queues.size();
+            for (size_t w = 0; w < workers; w++)
+            {
+                std::lock_guard<std::mutex> queueLock(m_queues[w]->mutex);
+                for (size_t i = taskCount * w / workers; i < taskCount * (w + 1) / workers; i++)
+                    m_queues[w]->tasks.push_back(i);
+            }
+            m_task = &task;
+            m_error = std::exception_ptr();
+            m_active = workers;
+            m_generation++;
+            m_wake.notify_all();
+
+            m_done.wait(lock, [this] { return m_active == 0; });
+            m_task = NULL;
+            if (m_error)
+                std::rethrow_exception(m_error);
+        }
+
+    protected:
+        struct task_queue
+        {
+            std::mutex mutex;
+            std::deque<size_t> tasks;
+        };
+
+        std::vector<std::unique_ptr<task_queue> > m_queues;
+        std::vector<std::thread> m_threads;
+        // held by run() for the whole batch
+        std::mutex m_runMutex;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        const std::function<void(size_t)> *m_task;
+        size_t m_generation;
+        size_t m_active;
+        bool m_stop;
+        std::exception_ptr m_error;
+
+        bool popTask(size_t worker, size_t &task)
+        {
+            {
+                task_queue &own = *m_queues[worker];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty())
+                {
+                    task = own.tasks.back();
+                    own.tasks.pop_back();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < m_queues.size(); i++)
+            {
+                task_queue &victim = *m_queues[(worker + i) % m_queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty())
+                {
+                    task = victim.tasks.front();
+                    victim.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void workerLoop(size_t worker)
+        {
+            size_t seenGeneration = 0;
+            for (;;)
+            {
+                const std::function<void(size_t)> *job;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wake.wait(lock, [&] { return m_stop || m_generation != seenGeneration; });
+                    if (m_stop)
+                        return;
+                    seenGeneration = m_generation;
+                    job = m_task;
+                }
+
+                size_t task;
+                while (popTask(worker, task))
+                {
+                    try
+                    {
+                        (*job)(task);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        if (!m_error)
+                            m_error = std::current_exception();
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_active == 0)
+                    m_done.notify_all();
+            }
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // Expressions
+    // ----------------------------------------------------------------------------
+
+    class decimal_expression
+    {
+    public:
+        enum OperationType
+        {
+            COLUMN,
+            CONSTANT,
+            ADD,
+            SUBTRACT,
+            MULTIPLY,
+            NEGATE
+        };
+
+        struct node
+        {
+            OperationType operation;
+            std::string name;
+            decimal value;
+            std::shared_ptr<const node> lhs;
+            std::shared_ptr<const node> rhs;
+        };
+
+        explicit decimal_expression(const std::shared_ptr<const node> &root) : m_root(root) {}
+
+        const node &getRoot() const { return *m_root; }
+
+        static decimal_expression makeLeaf(OperationType operation, const std::string &name, const decimal &value)
+        {
+            std::shared_ptr<node> result(new node());
+            result->operation = operation;
+            result->name = name;
+            result->value = value;
+            return decimal_expression(result);
+        }
+
+        static decimal_expression makeNode(OperationType operation, const decimal_expression &lhs,
+                                           const decimal_expression *rhs)
+        {
+            std::shared_ptr<node> result(new node());
+            result->operation = operation;
+            result->lhs = lhs.m_root;
+            if (rhs != NULL)
+                result->rhs = rhs->m_root;
+            return decimal_expression(result);
+        }
+
+    protected:
+        std::shared_ptr<const node> m_root;
+    };
+
+    inline decimal_expression column(const std::string &name)
+    {
+        return decimal_expression::makeLeaf(decimal_expression::COLUMN, name, decimal());
+    }
+
+    inline decimal_expression constant(const decimal &value)
+    {
+        return decimal_expression::makeLeaf(decimal_expression::CONSTANT, "", value);
+    }
+
+    inline decimal_expression operator+(const decimal_expression &lhs, const decimal_expression &rhs)
+    {
+        return decimal_expression::makeNode(decimal_expression::ADD, lhs, &rhs);
+    }
+
+    inline decimal_expression operator-(const decimal_expression &lhs, const decimal_expression &rhs)
+    {
+        return decimal_expression::makeNode(decimal_expression::SUBTRACT, lhs, &rhs);
+    }
+
+    inline decimal_expression operator*(const decimal_expression &lhs, const decimal_expression &rhs)
+    {
+        return decimal_expression::makeNode(decimal_expression::MULTIPLY, lhs, &rhs);
+    }
+
+    inline decimal_expression operator-(const decimal_expression &value)
+    {
+        return decimal_expression::makeNode(decimal_expression::NEGATE, value, NULL);
+    }
+
+    // ----------------------------------------------------------------------------
+    // Evaluator
+    // ----------------------------------------------------------------------------
+
+    class columnar_evaluator
+    {
+    public:
+        // chunkSize - rows evaluated at once by one task, default keeps buffers in L1/L2 cache
+        explicit columnar_evaluator(work_stealing_pool &pool, size_t chunkSize = 1024)
+        : m_pool(pool), m_chunkSize(chunkSize == 0 ? 1 : chunkSize)
+        {}
+
+        // binds column of unbiased values stored with given precision
+        void bind(const std::string &name, const int64 *values, int precision)
+        {
+            column_data data;
+            data.values = values;
+            data.precision = precision;
+            m_columns[name] = data;
+        }
+
+        // highest precision of columns, constants and result
+        static int maxPrecision() { return 18; }
+
+        // evaluates formula for rows 0..rows-1, out receives unbiased values with precisionOut digits
+        void evaluate(const decimal_expression &formula, size_t rows, const int precisionOut,
+                      RoundingType roundingType, int64 *out) const
+        {
+            if (precisionOut < 0 || precisionOut > maxPrecision())
+                throw "Precision out of range";
+
+            program code;
+            int depth = 0;
+            compile(formula.getRoot(), code, depth);
+
+            size_t chunks = (rows + m_chunkSize - 1) / m_chunkSize;
+            m_pool.run(chunks, [&](size_t chunk) {
+                size_t start = chunk * m_chunkSize;
+                size_t count = rows - start < m_chunkSize ? rows - start : m_chunkSize;
+                runChunk(code, start, count, precisionOut, roundingType, out + start);
+            });
+        }
+
+    protected:
+        struct column_data
+        {
+            const int64 *values;
+            int precision;
+        };
+
+        struct instruction
+        {
+            decimal_expression::OperationType operation;
+            const int64 *values;
+            int64 constant;
+            // precision of result
+            int precision;
+            // stack slot of result (and left operand)
+            int slot;
+            // digits aligning operands of addition / subtraction to common precision
+            int lhsShift;
+            int rhsShift;
+        };
+
+        struct program
+        {
+            std::vector<instruction> instructions;
+            int slots;
+            // highest precision of any instruction
+            int precision;
+
+            program() : slots(0), precision(0) {}
+        };
+
+        work_stealing_pool &m_pool;
+        size_t m_chunkSize;
+        std::map<std::string, column_data> m_columns;
+
+        static int checkPrecision(int precision)
+        {
+            if (precision < 0 || precision > maxPrecision())
+                throw "Precision out of range";
+            return precision;
+        }
+
+        // emits postfix code for node, result goes to stack slot "depth", returns precision
+        int compile(const decimal_expression::node &node, program &code, int depth) const
+        {
+            instruction item;
+            item.operation = node.operation;
+            item.values = NULL;
+            item.constant = 0;
+            item.slot = depth;
+            item.lhsShift = item.rhsShift = 0;
+
+            switch (node.operation)
+            {
+            case decimal_expression::COLUMN:
+            {
+                std::map<std::string, column_data>::const_iterator it = m_columns.find(node.name);
+                if (it == m_columns.end())
+                    throw "Unknown column";
+                item.values = it->second.values;
+                item.precision = checkPrecision(it->second.precision);
+                break;
+            }
+            case decimal_expression::CONSTANT:
+                item.constant = node.value.getUnbiased();
+                item.precision = checkPrecision(node.value.getPrecision());
+                break;
+            case decimal_expression::NEGATE:
+                item.precision = compile(*node.lhs, code, depth);
+                break;
+            default:
+            {
+                int lhsPrecision = compile(*node.lhs, code, depth);
+                int rhsPrecision = compile(*node.rhs, code, depth + 1);
+                if (node.operation == decimal_expression::MULTIPLY)
+                    item.precision = lhsPrecision + rhsPrecision;
+                else
+                {
+                    item.precision = lhsPrecision > rhsPrecision ? lhsPrecision : rhsPrecision;
+                    item.lhsShift = item.precision - lhsPrecision;
+                    item.rhsShift = item.precision - rhsPrecision;
+                }
+                break;
+            }
+            }
+
+            if (depth + 1 > code.slots)
+                code.slots = depth + 1;
+            if (item.precision > code.precision)
+                code.precision = item.precision;
+            code.instructions.push_back(item);
+            return item.precision;
+        }
+
+        // exact product, throws if it does not fit in int128
+        static int128 multiplyExact(const int128 &lhs, const int128 &rhs)
+        {
+            if (lhs.fitsInt64() && rhs.fitsInt64())
+                return int128::multiply(static_cast<int64>(lhs.lo), static_cast<int64>(rhs.lo));
+
+            const int128 *wide = &lhs;
+            const int128 *narrow = &rhs;
+            if (!narrow->fitsInt64())
+                std::swap(wide, narrow);
+            if (!narrow->fitsInt64())
+                throw "Value out of range";
+
+            int64 factor = narrow->toInt64();
+            int128 result = *wide;
+            result.multiplyBy(factor < 0 ? 0 - static_cast<uint64>(factor) : static_cast<uint64>(factor));
+            return factor < 0 ? -result : result;
+        }
+
+        // value * 10 ^ shift, throws if it does not fit in int128
+        static int128 scaleExact(const int128 &value, int shift)
+        {
+            if (shift == 0)
+                return value;
+            if (shift <= 18 && value.fitsInt64())
+                return int128::multiply(static_cast<int64>(value.lo), powerOfTen(shift));
+            return rescale(value, 0, shift, BANKERS);
+        }
+
+        static bool multiplyNarrow(int64 lhs, int64 rhs, int64 &result)
+        {
+#if defined(__GNUC__)
+            return !__builtin_mul_overflow(lhs, rhs, &result);
+#else
+            int128 product = int128::multiply(lhs, rhs);
+            result = static_cast<int64>(product.lo);
+            return product.fitsInt64();
+#endif
+        }
+
+        static bool addNarrow(int64 lhs, int64 rhs, int64 &result)
+        {
+#if defined(__GNUC__)
+            return !__builtin_add_overflow(lhs, rhs, &result);
+#else
+            result = static_cast<int64>(static_cast<uint64>(lhs) + static_cast<uint64>(rhs));
+            return (lhs < 0) != (rhs < 0) || (result < 0) == (lhs < 0);
+#endif
+        }
+
+        // value / divisor rounded to nearest, ties to even (BANKERS)
+        static int64 divideNarrow(int64 value, uint64 divisor)
+        {
+            uint64 magnitude = value < 0 ? 0 - static_cast<uint64>(value) : static_cast<uint64>(value);
+            uint64 quotient = magnitude / divisor;
+            uint64 remainder = magnitude % divisor;
+            if (remainder > divisor - remainder || (remainder == divisor - remainder && (quotient & 1) != 0))
+                quotient++;
+            return value < 0 ? static_cast<int64>(0 - quotient) : static_cast<int64>(quotient);
+        }
+
+        void runChunk(const program &code, size_t start, size_t count, const int precisionOut,
+                      RoundingType roundingType, int64 *out) const
+        {
+            // 64-bit lane needs every precision difference to have a 64-bit factor
+            if (code.precision > maxPrecision() ||
+                !runChunkNarrow(code, start, count, precisionOut, roundingType, out))
+                runChunkWide(code, start, count, precisionOut, roundingType, out);
+        }
+
+        // evaluates chunk with 64-bit intermediates, returns false if any of them overflows
+        bool runChunkNarrow(const program &code, size_t start, size_t count, const int precisionOut,
+                            RoundingType roundingType, int64 *out) const
+        {
+            static thread_local std::vector<std::vector<int64> > stack;
+            if (stack.size() < static_cast<size_t>(code.slots))
+                stack.resize(code.slots);
+            for (int slot = 0; slot < code.slots; slot++)
+                if (stack[slot].size() < count)
+                    stack[slot].resize(count);
+
+            bool isValid = true;
+            for (size_t n = 0; n < code.instructions.size() && isValid; n++)
+            {
+                const instruction &item = code.instructions[n];
+                int64 *result = &stack[item.slot][0];
+                const int64 *rhs = item.slot + 1 < code.slots ? &stack[item.slot + 1][0] : NULL;
+
+                switch (item.operation)
+                {
+                case decimal_expression::COLUMN:
+                    memcpy(result, item.values + start, count * sizeof(int64));
+                    break;
+                case decimal_expression::CONSTANT:
+                    std::fill(result, result + count, item.constant);
+                    break;
+                case decimal_expression::NEGATE:
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        isValid &= result[i] != -INT64_MAX_VALUE - 1;
+                        result[i] = static_cast<int64>(0 - static_cast<uint64>(result[i]));
+                    }
+                    break;
+                case decimal_expression::MULTIPLY:
+                    for (size_t i = 0; i < count; i++)
+                        isValid &= multiplyNarrow(result[i], rhs[i], result[i]);
+                    break;
+                case decimal_expression::ADD:
+                case decimal_expression::SUBTRACT:
+                {
+                    int64 lhsFactor = powerOfTen(item.lhsShift);
+                    int64 rhsFactor = powerOfTen(item.rhsShift);
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        int64 lhsValue = result[i];
+                        int64 rhsValue = rhs[i];
+                        if (lhsFactor != 1)
+                            isValid &= multiplyNarrow(lhsValue, lhsFactor, lhsValue);
+                        if (rhsFactor != 1)
+                            isValid &= multiplyNarrow(rhsValue, rhsFactor, rhsValue);
+                        if (item.operation == decimal_expression::SUBTRACT)
+                        {
+                            isValid &= rhsValue != -INT64_MAX_VALUE - 1;
+                            rhsValue = static_cast<int64>(0 - static_cast<uint64>(rhsValue));
+                        }
+                        isValid &= addNarrow(lhsValue, rhsValue, result[i]);
+                    }
+                    break;
+                }
+                }
+            }
+            if (!isValid)
+                return false;
+
+            int precision = code.instructions.back().precision;
+            const int64 *value = &stack[0][0];
+            if (precision > precisionOut)
+            {
+                uint64 divisor = static_cast<uint64>(powerOfTen(precision - precisionOut));
+                for (size_t i = 0; i < count; i++)
+                    out[i] = divideNarrow(value[i], divisor);
+            }
+            else
+            {
+                int64 factor = powerOfTen(precisionOut - precision);
+                for (size_t i = 0; i < count; i++)
+                    if (!multiplyNarrow(value[i], factor, out[i]))
+                        return false;
+            }
+            return true;
+        }
+
+        // exact evaluation with 128-bit intermediates
+        void runChunkWide(const program &code, size_t start, size_t count, const int precisionOut,
+                          RoundingType roundingType, int64 *out) const
+        {
+            // one buffer of chunk size per stack slot, reused by the thread between chunks
+            static thread_local std::vector<std::vector<int128> > stack;
+            if (stack.size() < static_cast<size_t>(code.slots))
+                stack.resize(code.slots);
+            for (int slot = 0; slot < code.slots; slot++)
+                if (stack[slot].size() < count)
+                    stack[slot].resize(count);
+
+            for (size_t n = 0; n < code.instructions.size(); n++)
+            {
+                const instruction &item = code.instructions[n];
+                int128 *result = &stack[item.slot][0];
+                const int128 *rhs = item.slot + 1 < code.slots ? &stack[item.slot + 1][0] : NULL;
+
+                switch (item.operation)
+                {
+                case decimal_expression::COLUMN:
+                    for (size_t i = 0; i < count; i++)
+                        result[i] = int128(item.values[start + i]);
+                    break;
+                case decimal_expression::CONSTANT:
+                    for (size_t i = 0; i < count; i++)
+                        result[i] = int128(item.constant);
+                    break;
+                case decimal_expression::NEGATE:
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        int128 value;
+                        subtractChecked(value, result[i]);
+                        result[i] = value;
+                    }
+                    break;
+                case decimal_expression::MULTIPLY:
+                    for (size_t i = 0; i < count; i++)
+                        result[i] = multiplyExact(result[i], rhs[i]);
+                    break;
+                case decimal_expression::ADD:
+                case decimal_expression::SUBTRACT:
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        int128 lhsValue = scaleExact(result[i], item.lhsShift);
+                        int128 rhsValue = scaleExact(rhs[i], item.rhsShift);
+                        if (item.operation == decimal_expression::SUBTRACT)
+                            subtractChecked(lhsValue, rhsValue);
+                        else
+                            addChecked(lhsValue, rhsValue);
+                        result[i] = lhsValue;
+                    }
+                    break;
+                }
+            }
+
+            int precision = code.instructions.back().precision;
+            const int128 *value = &stack[0][0];
+            for (size_t i = 0; i < count; i++)
+                out[i] = rescale(value[i], precision, precisionOut, roundingType).toInt64();
+        }
+    };
+
+} // namespace
+#endif // _DECIMAL_EVAL_H__
@@ -0,0 +1,357 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        decimal_fx.h
+// Purpose:     Cached currency conversion matrix with pre-scaled rates and
+//              versioned snapshots.
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _DECIMAL_FX_H__
+#define _DECIMAL_FX_H__
+
+#include "decimal.h"
+
+#ifndef DEC_HAS_CPP11
+#error "decimal_fx.h requires C++11"
+#endif
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#if defined(__cpp_lib_atomic_shared_ptr)
+#define DEC_HAS_ATOMIC_SHARED_PTR
+#endif
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file decimal_fx.h
+///
+/// Writers quote rates with setRate() and call publish(), which builds an
+/// immutable fx_rate_snapshot: quoted rates are stored without trailing zeros,
+/// missing reciprocal rates and cross rates (through base currency) are
+/// computed from the quoted rates as exact fractions and rounded once to
+/// rateDigits significant digits (at most 18 decimal places). Derived rates
+/// which round to zero are left unset, so conversions through them throw. Readers take the
+/// current snapshot with getSnapshot(), which never waits for publish(), and
+/// convert whole columns with one integer pass per column.
+///
+/// Sample usage:
+///   using namespace dec;
+///   fx_rate_matrix rates(12);
+///   size_t usd = rates.addCurrency("USD"), eur = rates.addCurrency("EUR");
+///   rates.setRate(eur, usd, decimal(1.0852, 4, BANKERS));
+///   rates.publish();
+///
+///   fx_rate_matrix::snapshot_ptr snapshot = rates.getSnapshot();
+///   snapshot->convert(amounts, count, usd, eur, 2, BANKERS, converted);
+
+namespace dec
+{
+    // rate stored as unbiased value and its precision
+    struct fx_rate
+    {
+        int64 value;
+        int precision;
+        bool isSet;
+
+        fx_rate() : value(0), precision(0), isSet(false) {}
+    };
+
+    class fx_rate_snapshot
+    {
+    public:
+        fx_rate_snapshot(uint64 version, const std::vector<std::string> &codes)
+        : m_version(version), m_codes(codes), m_rates(codes.size() * codes.size())
+        {
+            for (size_t i = 0; i < codes.size(); i++)
+                m_indexes[codes[i]] = i;
+        }
+
+        uint64 getVersion() const { return m_version; }
+        size_t getCurrencyCount() const { return m_codes.size(); }
+        const std::string &getCode(size_t currency) const { return m_codes.at(currency); }
+
+        size_t getCurrency(const std::string &code) const
+        {
+            std::map<std::string, size_t>::const_iterator it = m_indexes.find(code);
+            if (it == m_indexes.end())
+                throw "Unknown currency";
+            return it->second;
+        }
+
+        bool hasRate(size_t from, size_t to) const { return entry(from, to).isSet; }
+
+        decimal getRate(size_t from, size_t to) const
+        {
+            const fx_rate &rate = checkedEntry(from, to);
+            decimal result(0, rate.precision);
+            result.setUnbiased(rate.value);
+            return result;
+        }
+
+        decimal convert(const decimal &amount, size_t from, size_t to, const int precisionOut,
+                        RoundingType roundingType) const
+        {
+            int64 value = amount.getUnbiased();
+            int64 result;
+            convert(&value, 1, amount.getPrecision(), from, to, precisionOut, roundingType, &result);
+            decimal converted(0, precisionOut);
+            converted.setUnbiased(result);
+            return converted;
+        }
+
+        // converts column of decimals, values may have different precisions
+        void convert(const decimal *amounts, size_t count, size_t from, size_t to, const int precisionOut,
+                     RoundingType roundingType, decimal *out) const
+        {
+            for (size_t i = 0; i < count; i++)
+                out[i] = convert(amounts[i], from, to, precisionOut, roundingType);
+        }
+
+        // converts column of unbiased amounts sharing amountPrecision in one integer pass:
+        // out = round(amount * rate / 10 ^ (amountPrecision + ratePrecision - precisionOut))
+        void convert(const int64 *amounts, size_t count, int amountPrecision, size_t from, size_t to,
+                     const int precisionOut, RoundingType roundingType, int64 *out) const
+        {
+            const fx_rate &rate = checkedEntry(from, to);
+            int shift = amountPrecision + rate.precision - precisionOut;
+
+            if (shift <= 0)
+            {
+                int64 factor = int128::multiply(rate.value, powerOfTen(-shift)).toInt64();
+                for (size_t i = 0; i < count; i++)
+                    out[i] = int128::multiply(amounts[i], factor).toInt64();
+            }
+            else if (shift <= 18)
+            {
+                uint64 divisor = static_cast<uint64>(powerOfTen(shift));
+                for (size_t i = 0; i < count; i++)
+                    out[i] = divideRounded(int128::multiply(amounts[i], rate.value), divisor, roundingType).toInt64();
+            }
+            else
+            {
+                int128 divisor(powerOfTen(18));
+                divisor.multiplyBy(static_cast<uint64>(powerOfTen(shift - 18)));
+                for (size_t i = 0; i < count; i++)
+                    out[i] = divideRounded(int128::multiply(amounts[i], rate.value), divisor, roundingType).toInt64();
+            }
+        }
+
+    protected:
+        friend class fx_rate_matrix;
+
+        uint64 m_version;
+        std::vector<std::string> m_codes;
+        std::map<std::string, size_t> m_indexes;
+        std::vector<fx_rate> m_rates;
+
+        fx_rate &entry(size_t from, size_t to)
+        {
+            checkCurrencies(from, to);
+            return m_rates[from * m_codes.size() + to];
+        }
+
+        const fx_rate &entry(size_t from, size_t to) const
+        {
+            checkCurrencies(from, to);
+            return m_rates[from * m_codes.size() + to];
+        }
+
+        void checkCurrencies(size_t from, size_t to) const
+        {
+            if (from >= m_codes.size() || to >= m_codes.size())
+                throw "Unknown currency";
+        }
+
+        const fx_rate &checkedEntry(size_t from, size_t to) const
+        {
+            const fx_rate &rate = entry(from, to);
+            if (!rate.isSet)
+                throw "No rate for currency pair";
+            return rate;
+        }
+    };
+
+    class fx_rate_matrix
+    {
+    public:
+        typedef std::shared_ptr<const fx_rate_snapshot> snapshot_ptr;
+
+        // rateDigits - significant digits (1..18) kept in derived (reciprocal and cross) rates
+        explicit fx_rate_matrix(int rateDigits)
+        : m_rateDigits(rateDigits), m_baseCurrency(0), m_version(0)
+        {
+            if (rateDigits < 1 || rateDigits > 18)
+                throw "Rate digits out of range";
+            publish();
+        }
+
+        // returns index of currency, adds it if needed; first currency is the base for cross rates
+        size_t addCurrency(const std::string &code)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < m_codes.size(); i++)
+                if (m_codes[i] == code)
+                    return i;
+            m_codes.push_back(code);
+            return m_codes.size() - 1;
+        }
+
+        void setBaseCurrency(size_t currency)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (currency >= m_codes.size())
+                throw "Unknown currency";
+            m_baseCurrency = currency;
+        }
+
+        // quotes rate: 1 unit of "from" = rate units of "to"
+        void setRate(size_t from, size_t to, const decimal &rate)
+        {
+            if (rate.getUnbiased() <= 0)
+                throw "Rate must be positive";
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (from >= m_codes.size() || to >= m_codes.size())
+                throw "Unknown currency";
+            if (from == to)
+                throw "Rate of currency to itself is always 1";
+            m_quotes[std::make_pair(from, to)] = rate;
+        }
+
+        // builds new snapshot from current quotes and makes it visible to readers
+        snapshot_ptr publish()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::shared_ptr<fx_rate_snapshot> snapshot(new fx_rate_snapshot(++m_version, m_codes));
+            size_t count = m_codes.size();
+
+            for (size_t i = 0; i < count; i++)
+                snapshot->entry(i, i) = makeRate(1, 0);
+
+            for (quote_map::const_iterator it = m_quotes.begin(); it != m_quotes.end(); ++it)
+                snapshot->entry(it->first.first, it->first.second) =
+                    makeRate(it->second.getUnbiased(), it->second.getPrecision());
+
+            // derived rates use quoted legs only, so each of them is rounded once
+            for (size_t from = 0; from < count; from++)
+                for (size_t to = 0; to < count; to++)
+                {
+                    if (from == to || snapshot->entry(from, to).isSet)
+                        continue;
+                    int128 numerator, denominator;
+                    if (getQuotedLeg(to, from, denominator, numerator))
+                        snapshot->entry(from, to) = deriveRate(numerator, denominator);
+                    else if (from != m_baseCurrency && to != m_baseCurrency && m_baseCurrency < count)
+                    {
+                        int128 numeratorIn, denominatorIn, numeratorOut, denominatorOut;
+                        if (getLeg(from, m_baseCurrency, numeratorIn, denominatorIn)
+                            && getLeg(m_baseCurrency, to, numeratorOut, denominatorOut))
+                            snapshot->entry(from, to) = deriveRate(
+                                int128::multiply(numeratorIn.toInt64(), numeratorOut.toInt64()),
+                                int128::multiply(denominatorIn.toInt64(), denominatorOut.toInt64()));
+                    }
+                }
+
+            snapshot_ptr result(snapshot);
+#ifdef DEC_HAS_ATOMIC_SHARED_PTR
+            m_current.store(result);
+#else
+            std::atomic_store(&m_current, result);
+#endif
+            return result;
+        }
+
+        // readers do not take m_mutex, so they never wait for publish(); the atomic
+        // shared_ptr itself may use a short internal lock (e.g. in libstdc++),
+        // snapshot stays valid while it is referenced
+        snapshot_ptr getSnapshot() const
+        {
+#ifdef DEC_HAS_ATOMIC_SHARED_PTR
+            return m_current.load();
+#else
+            return std::atomic_load(&m_current);
+#endif
+        }
+
+    protected:
+        typedef std::map<std::pair<size_t, size_t>, decimal> quote_map;
+
+        int m_rateDigits;
+        size_t m_baseCurrency;
+        uint64 m_version;
+        std::vector<std::string> m_codes;
+        quote_map m_quotes;
+#ifdef DEC_HAS_ATOMIC_SHARED_PTR
+        std::atomic<snapshot_ptr> m_current;
+#else
+        snapshot_ptr m_current;
+#endif
+        std::mutex m_mutex;
+
+        // stores rate without trailing zeros, so products need fewer digits;
+        // zero (derived rate below 10 ^ -ratePrecision) is returned as not set
+        static fx_rate makeRate(int64 value, int precision)
+        {
+            if (value == 0)
+                return fx_rate();
+            uint64 magnitude = static_cast<uint64>(value);
+            int zeros = stripTrailingZeros(magnitude);
+            if (zeros > precision)
+            {
+                magnitude *= static_cast<uint64>(powerOfTen(zeros - precision));
+                zeros = precision;
+            }
+            fx_rate rate;
+            rate.value = static_cast<int64>(magnitude);
+            rate.precision = precision - zeros;
+            rate.isSet = true;
+            return rate;
+        }
+
+        // quoted rate from -> to as fraction numerator / denominator
+        bool getQuotedLeg(size_t from, size_t to, int128 &numerator, int128 &denominator) const
+        {
+            quote_map::const_iterator it = m_quotes.find(std::make_pair(from, to));
+            if (it == m_quotes.end())
+                return false;
+            numerator = int128(it->second.getUnbiased());
+            denominator = int128(powerOfTen(it->second.getPrecision()));
+            return true;
+        }
+
+        // quoted rate from -> to or reciprocal of quoted rate to -> from
+        bool getLeg(size_t from, size_t to, int128 &numerator, int128 &denominator) const
+        {
+            return getQuotedLeg(from, to, numerator, denominator) || getQuotedLeg(to, from, denominator, numerator);
+        }
+
+        // numerator / denominator rounded (BANKERS) to m_rateDigits significant digits
+        // (or to integer when it has more digits, or to 18 decimal places when it is tiny)
+        fx_rate deriveRate(const int128 &numerator, const int128 &denominator) const
+        {
+            int128 remainder;
+            int128 quotient = divideUnsigned(numerator, denominator, remainder);
+            const int128 lowest(powerOfTen(m_rateDigits - 1));
+            int precision = 0;
+            // long division, one decimal digit per step
+            while (quotient < lowest && precision < 18)
+            {
+                int128 dividend = remainder;
+                dividend.multiplyBy(10);
+                int128 digit = divideUnsigned(dividend, denominator, remainder);
+                quotient.multiplyBy(10);
+                quotient += digit;
+                precision++;
+            }
+            int128 rest = denominator;
+            rest -= remainder;
+            if (rest < remainder || (rest == remainder && (quotient.lo & 1) != 0))
+                quotient += int128(1);
+            return makeRate(quotient.toInt64(), precision);
+        }
+    };
+
+} // namespace
+#endif // _DECIMAL_FX_H__
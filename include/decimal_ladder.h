@@ -0,0 +1,362 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        decimal_ladder.h
+// Purpose:     Tick-indexed price ladder keyed by decimal price, for order
+//              book depth.
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _DECIMAL_LADDER_H__
+#define _DECIMAL_LADDER_H__
+
+#include "decimal.h"
+#include <map>
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file decimal_ladder.h
+///
+/// Price ladder maps decimal price with fixed tick size to tick number
+/// (unbiased price / unbiased tick size). Ticks inside a window of "capacity"
+/// ticks around center are stored in a flat array with occupancy bitmap,
+/// ticks outside the window go to a sparse std::map. Window can be moved
+/// with recenter() when market drifts.
+///
+/// Sample usage:
+///   using namespace dec;
+///   // tick 0.01, 4096 levels around 100.00
+///   price_ladder<int64> bids(decimal(0.01, 2, BANKERS), 2, 4096, decimal(100, 2));
+///   bids[decimal(99.98, 2, BANKERS)] += 500;
+///   decimal best;
+///   if (bids.getHighest(best)) ...
+
+namespace dec
+{
+    // T is level data (e.g. aggregated quantity), empty level holds T()
+    template<class T>
+    class price_ladder
+    {
+    public:
+        price_ladder(const decimal &tickSize, int precision, size_t capacity, const decimal &center)
+        : m_precision(precision), m_size(0)
+        {
+            if (capacity == 0)
+                throw "Ladder capacity can not be zero";
+            m_tickSize = toUnbiased(tickSize);
+            if (m_tickSize <= 0)
+                throw "Tick size must be positive";
+            m_levels.resize(capacity);
+            m_bits.resize((capacity + 63) / 64, 0);
+            m_base = toTick(center) - static_cast<int64>(capacity / 2);
+            m_lowest = m_highest = noIndex();
+        }
+
+        size_t size() const { return m_size; }
+        bool isEmpty() const { return m_size == 0; }
+        int getPrecision() const { return m_precision; }
+        size_t getCapacity() const { return m_levels.size(); }
+
+        // lowest / highest tick stored in flat array
+        int64 getFirstDenseTick() const { return m_base; }
+        int64 getLastDenseTick() const { return m_base + static_cast<int64>(m_levels.size()) - 1; }
+
+        // converts price to tick number, throws if price is not a multiple of tick size
+        int64 toTick(const decimal &price) const
+        {
+            int64 value = toUnbiased(price);
+            if (value % m_tickSize != 0)
+                throw "Price is not a multiple of tick size";
+            return value / m_tickSize;
+        }
+
+        decimal fromTick(int64 tick) const
+        {
+            decimal result(0, m_precision);
+            result.setUnbiased(tick * m_tickSize);
+            return result;
+        }
+
+        // ----- price based interface -----
+
+        T &operator[](const decimal &price) { return atTick(toTick(price)); }
+        T *find(const decimal &price) { return findTick(toTick(price)); }
+        bool contains(const decimal &price) const { return containsTick(toTick(price)); }
+        bool erase(const decimal &price) { return eraseTick(toTick(price)); }
+
+        bool getLowest(decimal &price) const { return convert(lowestTick(), price); }
+        bool getHighest(decimal &price) const { return convert(highestTick(), price); }
+
+        bool getNextAbove(const decimal &price, decimal &next) const
+        {
+            int64 tick;
+            return nextTickAbove(toTick(price), tick) && convert(tick, next);
+        }
+
+        bool getNextBelow(const decimal &price, decimal &next) const
+        {
+            int64 tick;
+            return nextTickBelow(toTick(price), tick) && convert(tick, next);
+        }
+
+        // ----- tick based interface -----
+
+        // returns level for tick, creating empty level if needed
+        T &atTick(int64 tick)
+        {
+            if (isDense(tick))
+            {
+                size_t index = static_cast<size_t>(tick - m_base);
+                if (!testBit(index))
+                {
+                    setBit(index);
+                    m_size++;
+                    if (m_lowest == noIndex() || index < m_lowest)
+                        m_lowest = index;
+                    if (m_highest == noIndex() || index > m_highest)
+                        m_highest = index;
+                }
+                return m_levels[index];
+            }
+
+            typename sparse_map::iterator it = m_sparse.find(tick);
+            if (it == m_sparse.end())
+            {
+                it = m_sparse.insert(std::make_pair(tick, T())).first;
+                m_size++;
+            }
+            return it->second;
+        }
+
+        T *findTick(int64 tick)
+        {
+            if (isDense(tick))
+            {
+                size_t index = static_cast<size_t>(tick - m_base);
+                return testBit(index) ? &m_levels[index] : NULL;
+            }
+            typename sparse_map::iterator it = m_sparse.find(tick);
+            return it == m_sparse.end() ? NULL : &it->second;
+        }
+
+        bool containsTick(int64 tick) const
+        {
+            if (isDense(tick))
+                return testBit(static_cast<size_t>(tick - m_base));
+            return m_sparse.find(tick) != m_sparse.end();
+        }
+
+        bool eraseTick(int64 tick)
+        {
+            if (isDense(tick))
+            {
+                size_t index = static_cast<size_t>(tick - m_base);
+                if (!testBit(index))
+                    return false;
+                clearBit(index);
+                m_levels[index] = T();
+                m_size--;
+                if (index == m_lowest)
+                    m_lowest = nextSet(index + 1);
+                if (index == m_highest)
+                    m_highest = previousSet(index);
+                return true;
+            }
+            if (m_sparse.erase(tick) == 0)
+                return false;
+            m_size--;
+            return true;
+        }
+
+        // returns npos() if ladder is empty
+        int64 lowestTick() const
+        {
+            if (!m_sparse.empty() && m_sparse.begin()->first < m_base)
+                return m_sparse.begin()->first;
+            if (m_lowest != noIndex())
+                return m_base + static_cast<int64>(m_lowest);
+            return m_sparse.empty() ? npos() : m_sparse.begin()->first;
+        }
+
+        int64 highestTick() const
+        {
+            if (!m_sparse.empty() && m_sparse.rbegin()->first > getLastDenseTick())
+                return m_sparse.rbegin()->first;
+            if (m_highest != noIndex())
+                return m_base + static_cast<int64>(m_highest);
+            return m_sparse.empty() ? npos() : m_sparse.rbegin()->first;
+        }
+
+        // finds first occupied tick greater than tick
+        bool nextTickAbove(int64 tick, int64 &next) const
+        {
+            int64 best = npos();
+            typename sparse_map::const_iterator it = m_sparse.upper_bound(tick);
+            if (it != m_sparse.end())
+                best = it->first;
+            if (m_lowest != noIndex() && tick < getLastDenseTick())
+            {
+                size_t from = tick < m_base ? 0 : static_cast<size_t>(tick - m_base) + 1;
+                size_t index = nextSet(from > m_lowest ? from : m_lowest);
+                if (index != noIndex() && (best == npos() || m_base + static_cast<int64>(index) < best))
+                    best = m_base + static_cast<int64>(index);
+            }
+            next = best;
+            return best != npos();
+        }
+
+        // finds first occupied tick lower than tick
+        bool nextTickBelow(int64 tick, int64 &next) const
+        {
+            int64 best = npos();
+            typename sparse_map::const_iterator it = m_sparse.lower_bound(tick);
+            if (it != m_sparse.begin())
+                best = (--it)->first;
+            if (m_highest != noIndex() && tick > m_base)
+            {
+                size_t to = tick > getLastDenseTick() ? m_levels.size() : static_cast<size_t>(tick - m_base);
+                size_t index = previousSet(to < m_highest + 1 ? to : m_highest + 1);
+                if (index != noIndex() && (best == npos() || m_base + static_cast<int64>(index) > best))
+                    best = m_base + static_cast<int64>(index);
+            }
+            next = best;
+            return best != npos();
+        }
+
+        // moves flat window so it is centered at given price, levels which leave the
+        // window go to sparse storage and sparse levels inside new window become dense
+        void recenter(const decimal &center)
+        {
+            int64 base = toTick(center) - static_cast<int64>(m_levels.size() / 2);
+            if (base == m_base)
+                return;
+
+            sparse_map levels;
+            levels.swap(m_sparse);
+            for (size_t index = nextSet(0); index != noIndex(); index = nextSet(index + 1))
+            {
+                levels.insert(std::make_pair(m_base + static_cast<int64>(index), m_levels[index]));
+                m_levels[index] = T();
+            }
+            std::fill(m_bits.begin(), m_bits.end(), 0);
+            m_lowest = m_highest = noIndex();
+            m_size = 0;
+            m_base = base;
+
+            for (typename sparse_map::iterator it = levels.begin(); it != levels.end(); ++it)
+                atTick(it->first) = it->second;
+        }
+
+        // tick value used when there is no level
+        static int64 npos() { return INT64_MAX_VALUE; }
+
+    protected:
+        typedef std::map<int64, T> sparse_map;
+
+        int m_precision;
+        int64 m_tickSize;
+        int64 m_base;
+        size_t m_size;
+        std::vector<T> m_levels;
+        std::vector<uint64> m_bits;
+        sparse_map m_sparse;
+        // lowest / highest occupied index in flat array, noIndex() if none
+        size_t m_lowest;
+        size_t m_highest;
+
+        int64 toUnbiased(const decimal &price) const
+        {
+            if (price.getPrecision() == m_precision)
+                return price.getUnbiased();
+            int128 value(price.getUnbiased());
+            int128 scaled = rescale(value, price.getPrecision(), m_precision, BANKERS);
+            if (price.getPrecision() > m_precision
+                && rescale(scaled, m_precision, price.getPrecision(), BANKERS) != value)
+                throw "Price has more digits than ladder precision";
+            return scaled.toInt64();
+        }
+
+        static size_t noIndex() { return static_cast<size_t>(-1); }
+
+        bool convert(int64 tick, decimal &price) const
+        {
+            if (tick == npos())
+                return false;
+            price = fromTick(tick);
+            return true;
+        }
+
+        bool isDense(int64 tick) const
+        {
+            return tick >= m_base && tick - m_base < static_cast<int64>(m_levels.size());
+        }
+
+        bool testBit(size_t index) const { return ((m_bits[index >> 6] >> (index & 63)) & 1) != 0; }
+        void setBit(size_t index) { m_bits[index >> 6] |= 1ULL << (index & 63); }
+        void clearBit(size_t index) { m_bits[index >> 6] &= ~(1ULL << (index & 63)); }
+
+        static int lowestBit(uint64 word)
+        {
+#if defined(__GNUC__)
+            return __builtin_ctzll(word);
+#else
+            int bit = 0;
+            while ((word & 1) == 0)
+            {
+                word >>= 1;
+                bit++;
+            }
+            return bit;
+#endif
+        }
+
+        static int highestBit(uint64 word)
+        {
+#if defined(__GNUC__)
+            return 63 - __builtin_clzll(word);
+#else
+            int bit = 63;
+            while ((word >> 63) == 0)
+            {
+                word <<= 1;
+                bit--;
+            }
+            return bit;
+#endif
+        }
+
+        // first occupied index >= from, noIndex() if none
+        size_t nextSet(size_t from) const
+        {
+            if (from >= m_levels.size())
+                return noIndex();
+            size_t word = from >> 6;
+            uint64 bits = m_bits[word] & (~0ULL << (from & 63));
+            while (bits == 0)
+            {
+                if (++word >= m_bits.size())
+                    return noIndex();
+                bits = m_bits[word];
+            }
+            return (word << 6) + lowestBit(bits);
+        }
+
+        // last occupied index < to, noIndex() if none
+        size_t previousSet(size_t to) const
+        {
+            if (to == 0)
+                return noIndex();
+            size_t last = to - 1;
+            size_t word = last >> 6;
+            uint64 bits = m_bits[word] & (~0ULL >> (63 - (last & 63)));
+            while (bits == 0)
+            {
+                if (word == 0)
+                    return noIndex();
+                bits = m_bits[--word];
+            }
+            return (word << 6) + highestBit(bits);
+        }
+    };
+
+} // namespace
+#endif // _DECIMAL_LADDER_H__
@@ -0,0 +1,214 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        decimal_stats.h
+// Purpose:     Exact statistical kernels (mean, variance, standard deviation)
+//              over decimal values.
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _DECIMAL_STATS_H__
+#define _DECIMAL_STATS_H__
+
+#include "decimal.h"
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file decimal_stats.h
+///
+/// Moments are kept as exact integer sums (count, sum, sum of squares), so
+/// results are deterministic on every machine and do not depend on order of
+/// values. Partial results from separate threads can be combined with merge().
+///
+/// Sums are kept for deviations from a shift value (the first value added),
+/// so magnitudes stay small for clustered data such as prices. All 128-bit
+/// arithmetic is checked and throws instead of wrapping.
+///
+/// Sample usage:
+///   using namespace dec;
+///   decimal_moments moments = computeMoments(pnl, count);
+///   decimal sd = moments.getStandardDeviation(2, BANKERS, true);
+
+namespace dec
+{
+    class decimal_moments
+    {
+    public:
+        // inputs are stored with given precision, values with more digits are rounded (BANKERS)
+        explicit decimal_moments(int precision) : m_precision(precision), m_count(0), m_shift(0) {}
+
+        int getPrecision() const { return m_precision; }
+        uint64 getCount() const { return m_count; }
+
+        // single-pass update
+        void add(const decimal &value)
+        {
+            int64 unbiased = value.getUnbiased();
+            if (value.getPrecision() != m_precision)
+                unbiased = rescale(int128(unbiased), value.getPrecision(), m_precision, BANKERS).toInt64();
+            addUnbiased(unbiased);
+        }
+
+        void addUnbiased(int64 value)
+        {
+            if (m_count == 0)
+                m_shift = value;
+            int128 deviation(value);
+            deviation -= int128(m_shift);
+            m_count++;
+            addChecked(m_sum, deviation);
+            addChecked(m_sumOfSquares, multiplyChecked(deviation, deviation));
+        }
+
+        // combines partial results, e.g. computed by separate threads
+        void merge(const decimal_moments &other)
+        {
+            if (other.m_precision != m_precision)
+                throw "Moments precision mismatch";
+            if (other.m_count == 0)
+                return;
+            if (m_count == 0)
+            {
+                *this = other;
+                return;
+            }
+
+            // moves other sums to this shift: d = x - m_shift = (x - other.m_shift) + delta
+            int128 delta(other.m_shift);
+            delta -= int128(m_shift);
+            int128 count(0ULL, other.m_count);
+            int128 sum = other.m_sum;
+            addChecked(sum, multiplyChecked(count, delta));
+            int128 sumOfSquares = other.m_sumOfSquares;
+            int128 twiceDelta = delta;
+            addChecked(twiceDelta, delta);
+            addChecked(sumOfSquares, multiplyChecked(twiceDelta, other.m_sum));
+            addChecked(sumOfSquares, multiplyChecked(count, multiplyChecked(delta, delta)));
+
+            m_count += other.m_count;
+            addChecked(m_sum, sum);
+            addChecked(m_sumOfSquares, sumOfSquares);
+        }
+
+        decimal getMean(const int precisionOut, RoundingType roundingType) const
+        {
+            if (m_count == 0)
+                throw "No values";
+            int128 denominator(0ULL, m_count);
+            int128 numerator = m_sum;
+            addChecked(numerator, multiplyChecked(denominator, int128(m_shift)));
+            if (precisionOut > m_precision)
+                numerator.multiplyBy(static_cast<uint64>(powerOfTen(precisionOut - m_precision)));
+            else if (precisionOut < m_precision)
+                denominator.multiplyBy(static_cast<uint64>(powerOfTen(m_precision - precisionOut)));
+            return makeDecimal(divideRounded(numerator, denominator, roundingType).toInt64(), precisionOut);
+        }
+
+        // sample = true divides by (count - 1), otherwise by count
+        decimal getVariance(const int precisionOut, RoundingType roundingType, bool sample) const
+        {
+            int128 numerator, denominator;
+            getVarianceFraction(precisionOut, sample, numerator, denominator);
+            return makeDecimal(divideRounded(numerator, denominator, roundingType).toInt64(), precisionOut);
+        }
+
+        decimal getStandardDeviation(const int precisionOut, RoundingType roundingType, bool sample) const
+        {
+            // sd * 10 ^ q = sqrt(variance * 10 ^ 2q)
+            int128 numerator, denominator;
+            getVarianceFraction(2 * precisionOut, sample, numerator, denominator);
+            return makeDecimal(squareRootRounded(numerator, denominator, roundingType), precisionOut);
+        }
+
+    protected:
+        int m_precision;
+        uint64 m_count;
+        // sums of (value - m_shift) and (value - m_shift) ^ 2
+        int64 m_shift;
+        int128 m_sum;
+        int128 m_sumOfSquares;
+
+        static decimal makeDecimal(int64 unbiased, int precision)
+        {
+            decimal result(0, precision);
+            result.setUnbiased(unbiased);
+            return result;
+        }
+
+        static int128 multiplyChecked(const int128 &lhs, const int128 &rhs)
+        {
+            int128 lhsAbs = lhs.magnitude();
+            int128 rhsAbs = rhs.magnitude();
+            if (lhsAbs.hi != 0 && rhsAbs.hi != 0)
+                throw "Value out of range";
+            int128 result = lhsAbs.hi != 0 ? lhsAbs : rhsAbs;
+            result.multiplyBy(lhsAbs.hi != 0 ? rhsAbs.lo : lhsAbs.lo);
+            return lhs.isNegative() != rhs.isNegative() ? -result : result;
+        }
+
+        // variance * 10 ^ precisionOut = numerator / denominator, where
+        // numerator = count * sumOfSquares - sum ^ 2 (scaled), denominator = count * (count or count - 1) (scaled)
+        void getVarianceFraction(int precisionOut, bool sample, int128 &numerator, int128 &denominator) const
+        {
+            uint64 divisor = sample ? m_count - 1 : m_count;
+            if (m_count == 0 || divisor == 0)
+                throw "Not enough values";
+
+            // non-negative by Cauchy-Schwarz, so subtraction can not overflow
+            numerator = multiplyChecked(m_sumOfSquares, int128(0ULL, m_count));
+            numerator -= multiplyChecked(m_sum, m_sum);
+
+            multiply128(m_count, divisor, denominator.hi, denominator.lo);
+            for (int scale = precisionOut - 2 * m_precision; scale != 0; )
+            {
+                int step = scale > 18 ? 18 : (scale < -18 ? -18 : scale);
+                if (step > 0)
+                    numerator.multiplyBy(static_cast<uint64>(powerOfTen(step)));
+                else
+                    denominator.multiplyBy(static_cast<uint64>(powerOfTen(-step)));
+                scale -= step;
+            }
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // Batch kernels
+    // ----------------------------------------------------------------------------
+
+    // two-pass kernel: first pass finds the highest precision so that all values
+    // are added exactly, second pass accumulates integer sums
+    inline decimal_moments computeMoments(const decimal *values, size_t count)
+    {
+        int precisionHighest = 0;
+        for (size_t i = 0; i < count; i++)
+            if (values[i].getPrecision() > precisionHighest)
+                precisionHighest = values[i].getPrecision();
+
+        decimal_moments moments(precisionHighest);
+        for (size_t i = 0; i < count; i++)
+            moments.add(values[i]);
+        return moments;
+    }
+
+    // moments of column of unbiased values sharing one precision
+    inline decimal_moments computeMoments(const int64 *values, size_t count, int precision)
+    {
+        decimal_moments moments(precision);
+        for (size_t i = 0; i < count; i++)
+            moments.addUnbiased(values[i]);
+        return moments;
+    }
+
+    inline decimal variance(const decimal *values, size_t count, const int precisionOut,
+                            RoundingType roundingType, bool sample)
+    {
+        return computeMoments(values, count).getVariance(precisionOut, roundingType, sample);
+    }
+
+    inline decimal standardDeviation(const decimal *values, size_t count, const int precisionOut,
+                                     RoundingType roundingType, bool sample)
+    {
+        return computeMoments(values, count).getStandardDeviation(precisionOut, roundingType, sample);
+    }
+
+} // namespace
+#endif // _DECIMAL_STATS_H__
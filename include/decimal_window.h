@@ -0,0 +1,221 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        decimal_window.h
+// Purpose:     Incremental rolling-window aggregates (sum, mean, VWAP, min, max)
+//              over streams of decimal values.
+// Licence:     BSD
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef _DECIMAL_WINDOW_H__
+#define _DECIMAL_WINDOW_H__
+
+#include "decimal.h"
+#include <deque>
+
+// ----------------------------------------------------------------------------
+// Description
+// ----------------------------------------------------------------------------
+/// \file decimal_window.h
+///
+/// Window keeps exact 128-bit running sums, so each update costs O(1)
+/// (amortized, min / max use monotonic queues) and rounding happens only
+/// when an aggregate is read.
+///
+/// Prices and quantities are stored with fixed precision given in constructor,
+/// inputs with higher precision are rounded (BANKERS) once on push.
+///
+/// Sample usage:
+///   using namespace dec;
+///   // last 1000 ticks, no time limit, prices with 4 digits, quantities with 0
+///   rolling_window window(1000, 0, 4, 0);
+///   window.push(price, quantity, timestamp);
+///   decimal vwap = window.getVwap(4, BANKERS);
+
+namespace dec
+{
+    class rolling_window
+    {
+    public:
+        // maxCount - maximum number of entries kept (0 = unlimited)
+        // maxAge - entries with timestamp <= newest timestamp - maxAge are dropped (0 = unlimited)
+        rolling_window(size_t maxCount, int64 maxAge, int pricePrecision, int quantityPrecision)
+        : m_maxCount(maxCount), m_maxAge(maxAge),
+          m_pricePrecision(pricePrecision), m_quantityPrecision(quantityPrecision),
+          m_sequence(0)
+        {}
+
+        size_t getCount() const { return m_entries.size(); }
+        bool isEmpty() const { return m_entries.empty(); }
+
+        void clear()
+        {
+            m_entries.clear();
+            m_minimums.clear();
+            m_maximums.clear();
+            m_sumPrice = int128();
+            m_sumQuantity = int128();
+            m_sumNotional = int128();
+        }
+
+        // adds value with quantity 1
+        void push(const decimal &price, int64 timestamp = 0)
+        {
+            pushUnbiased(toUnbiased(price, m_pricePrecision), powerOfTen(m_quantityPrecision), timestamp);
+        }
+
+        void push(const decimal &price, const decimal &quantity, int64 timestamp = 0)
+        {
+            pushUnbiased(toUnbiased(price, m_pricePrecision), toUnbiased(quantity, m_quantityPrecision), timestamp);
+        }
+
+        // drops entries which are too old at time now
+        void expire(int64 now)
+        {
+            if (m_maxAge <= 0)
+                return;
+            while (!m_entries.empty() && m_entries.front().timestamp <= now - m_maxAge)
+                popFront();
+        }
+
+        decimal getSum(const int precisionOut, RoundingType roundingType) const
+        {
+            return makeDecimal(rescale(m_sumPrice, m_pricePrecision, precisionOut, roundingType), precisionOut);
+        }
+
+        decimal getMean(const int precisionOut, RoundingType roundingType) const
+        {
+            if (m_entries.empty())
+                throw "Window is empty";
+            return divideToPrecision(m_sumPrice, int128(0ULL, static_cast<uint64>(m_entries.size())),
+                                     precisionOut, roundingType);
+        }
+
+        // volume weighted average price: sum(price * quantity) / sum(quantity)
+        decimal getVwap(const int precisionOut, RoundingType roundingType) const
+        {
+            if (m_sumQuantity.isNegative() || m_sumQuantity == int128())
+                throw "Window has no volume";
+            return divideToPrecision(m_sumNotional, m_sumQuantity, precisionOut, roundingType);
+        }
+
+        decimal getMin() const
+        {
+            if (m_entries.empty())
+                throw "Window is empty";
+            return makeDecimal(int128(m_minimums.front().price), m_pricePrecision);
+        }
+
+        decimal getMax() const
+        {
+            if (m_entries.empty())
+                throw "Window is empty";
+            return makeDecimal(int128(m_maximums.front().price), m_pricePrecision);
+        }
+
+    protected:
+        struct entry
+        {
+            int64 price;
+            int64 quantity;
+            int64 timestamp;
+            uint64 sequence;
+        };
+
+        size_t m_maxCount;
+        int64 m_maxAge;
+        int m_pricePrecision;
+        int m_quantityPrecision;
+        uint64 m_sequence;
+        std::deque<entry> m_entries;
+        // monotonic queues: increasing prices for minimum, decreasing for maximum
+        std::deque<entry> m_minimums;
+        std::deque<entry> m_maximums;
+        int128 m_sumPrice;
+        int128 m_sumQuantity;
+        // sum of price * quantity, stored with m_pricePrecision + m_quantityPrecision digits
+        int128 m_sumNotional;
+
+        static int64 toUnbiased(const decimal &value, int precision)
+        {
+            if (value.getPrecision() == precision)
+                return value.getUnbiased();
+            return rescale(int128(value.getUnbiased()), value.getPrecision(), precision, BANKERS).toInt64();
+        }
+
+        static decimal makeDecimal(const int128 &value, int precision)
+        {
+            decimal result(0, precision);
+            result.setUnbiased(value.toInt64());
+            return result;
+        }
+
+        // returns numerator / denominator with precisionOut digits, quotient has m_pricePrecision digits
+        decimal divideToPrecision(const int128 &numerator, const int128 &denominator, const int precisionOut,
+                                  RoundingType roundingType) const
+        {
+            int128 value = numerator;
+            int128 divisor = denominator;
+            for (int scale = precisionOut - m_pricePrecision; scale != 0; )
+            {
+                int step = scale > 18 ? 18 : (scale < -18 ? -18 : scale);
+                if (step > 0)
+                    value.multiplyBy(static_cast<uint64>(powerOfTen(step)));
+                else
+                    divisor.multiplyBy(static_cast<uint64>(powerOfTen(-step)));
+                scale -= step;
+            }
+            return makeDecimal(divideRounded(value, divisor, roundingType), precisionOut);
+        }
+
+        void pushUnbiased(int64 price, int64 quantity, int64 timestamp)
+        {
+            if (quantity < 0)
+                throw "Quantity can not be negative";
+
+            entry item;
+            item.price = price;
+            item.quantity = quantity;
+            item.timestamp = timestamp;
+            item.sequence = m_sequence++;
+
+            // sums are updated only when none of them overflows
+            int128 sumPrice = m_sumPrice;
+            int128 sumQuantity = m_sumQuantity;
+            int128 sumNotional = m_sumNotional;
+            addChecked(sumPrice, int128(price));
+            addChecked(sumQuantity, int128(quantity));
+            addChecked(sumNotional, int128::multiply(price, quantity));
+
+            m_entries.push_back(item);
+            m_sumPrice = sumPrice;
+            m_sumQuantity = sumQuantity;
+            m_sumNotional = sumNotional;
+
+            while (!m_minimums.empty() && m_minimums.back().price >= price)
+                m_minimums.pop_back();
+            m_minimums.push_back(item);
+            while (!m_maximums.empty() && m_maximums.back().price <= price)
+                m_maximums.pop_back();
+            m_maximums.push_back(item);
+
+            if (m_maxCount > 0)
+                while (m_entries.size() > m_maxCount)
+                    popFront();
+            expire(timestamp);
+        }
+
+        void popFront()
+        {
+            const entry &item = m_entries.front();
+            m_sumPrice -= int128(item.price);
+            m_sumQuantity -= int128(item.quantity);
+            m_sumNotional -= int128::multiply(item.price, item.quantity);
+            if (m_minimums.front().sequence == item.sequence)
+                m_minimums.pop_front();
+            if (m_maximums.front().sequence == item.sequence)
+                m_maximums.pop_front();
+            m_entries.pop_front();
+        }
+    };
+
+} // namespace
+#endif // _DECIMAL_WINDOW_H__
@@ -0,0 +1,280 @@
+/*
+ * Purpose: Micro benchmarks for Decimal class (not a unit test)
+ *          Build with C++11 or newer and optimizations enabled, e.g.
+ *          g++ -O2 -std=c++11 -pthread -I../include decimal_bench.cpp
+ *
+ */
+
+#include "decimal.h"
+#include "decimal_ladder.h"
+#include "decimal_eval.h"
+#include <cstdio>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <map>
+
+using namespace dec;
+
+static volatile int64 g_sink;
+
+typedef std::chrono::steady_clock::time_point time_point;
+
+// wall clock time, so multi-threaded runs are measured correctly
+static time_point now()
+{
+    return std::chrono::steady_clock::now();
+}
+
+static double elapsedNs(time_point start, size_t operations)
+{
+    return std::chrono::duration<double, std::nano>(now() - start).count() / (double)operations;
+}
+
+// open addressing (linear probing) map with decimal keys, used only for comparison
+class flat_decimal_map
+{
+public:
+    explicit flat_decimal_map(size_t capacity)
+    {
+        size_t size = 16;
+        while (size < capacity * 2)
+            size *= 2;
+        m_keys.resize(size);
+        m_values.resize(size);
+        m_used.resize(size, false);
+        m_mask = size - 1;
+    }
+
+    void insert(const decimal &key, int64 value)
+    {
+        size_t slot = key.hash() & m_mask;
+        while (m_used[slot] && m_keys[slot] != key)
+            slot = (slot + 1) & m_mask;
+        m_keys[slot] = key;
+        m_values[slot] = value;
+        m_used[slot] = true;
+    }
+
+    const int64 *find(const decimal &key) const
+    {
+        size_t slot = key.hash() & m_mask;
+        while (m_used[slot])
+        {
+            if (m_keys[slot] == key)
+                return &m_values[slot];
+            slot = (slot + 1) & m_mask;
+        }
+        return 0;
+    }
+
+private:
+    std::vector<decimal> m_keys;
+    std::vector<int64> m_values;
+    std::vector<bool> m_used;
+    size_t m_mask;
+};
+
+static void benchHash()
+{
+    const size_t keyCount = 100000;
+    const size_t lookups = 5000000;
+
+    // prices stored with precision 4, looked up with precision 2
+    std::vector<decimal> keys, probes;
+    for (size_t i = 0; i < keyCount; i++)
+    {
+        decimal key(0, 4);
+        key.setUnbiased(1000000 + static_cast<int64>(i) * 100);
+        keys.push_back(key);
+        decimal probe(0, 2);
+        probe.setUnbiased(10000 + static_cast<int64>(i));
+        probes.push_back(probe);
+    }
+
+    time_point start = now();
+    int64 sum = 0;
+    for (size_t i = 0; i < lookups; i++)
+        sum += static_cast<int64>(probes[i % keyCount].hash() & 1);
+    g_sink = sum;
+    printf("decimal::hash                  %8.2f ns/op\n", elapsedNs(start, lookups));
+
+    std::unordered_map<decimal, int64> hashMap;
+    flat_decimal_map flatMap(keyCount);
+    for (size_t i = 0; i < keyCount; i++)
+    {
+        hashMap[keys[i]] = static_cast<int64>(i);
+        flatMap.insert(keys[i], static_cast<int64>(i));
+    }
+
+    start = now();
+    sum = 0;
+    for (size_t i = 0; i < lookups; i++)
+        sum += hashMap.find(probes[(i * 7919) % keyCount])->second;
+    g_sink = sum;
+    printf("std::unordered_map find        %8.2f ns/op\n", elapsedNs(start, lookups));
+
+    start = now();
+    sum = 0;
+    for (size_t i = 0; i < lookups; i++)
+        sum += *flatMap.find(probes[(i * 7919) % keyCount]);
+    g_sink = sum;
+    printf("flat_decimal_map find          %8.2f ns/op\n", elapsedNs(start, lookups));
+}
+
+static void benchLadder()
+{
+    const size_t levels = 2000;
+    const size_t updates = 5000000;
+
+    std::vector<decimal> prices;
+    for (size_t i = 0; i < levels; i++)
+    {
+        decimal price(0, 2);
+        price.setUnbiased(990000 + static_cast<int64>(i) * 5);
+        prices.push_back(price);
+    }
+
+    std::map<decimal, int64> tree;
+    time_point start = now();
+    for (size_t i = 0; i < updates; i++)
+        tree[prices[(i * 7919) % levels]] += 1;
+    g_sink = tree.rbegin()->second;
+    printf("std::map<decimal> update       %8.2f ns/op\n", elapsedNs(start, updates));
+
+    price_ladder<int64> ladder(decimal(0.05, 2, BANKERS), 2, 4096, prices[levels / 2]);
+    start = now();
+    for (size_t i = 0; i < updates; i++)
+        ladder[prices[(i * 7919) % levels]] += 1;
+    decimal best;
+    ladder.getHighest(best);
+    g_sink = best.getUnbiased();
+    printf("price_ladder update            %8.2f ns/op\n", elapsedNs(start, updates));
+}
+
+static void benchScalar()
+{
+    const size_t operations = 10000000;
+    decimal price(0, 4);
+    price.setUnbiased(1234567);
+    int64 sum = 0;
+
+    // previous generic path: temporary decimal and mixed-precision multiply
+    time_point start = now();
+    for (size_t i = 0; i < operations; i++)
+    {
+        decimal quantity(static_cast<int>(i & 1023), 2);
+        sum += decimal::multiply(price, quantity, 2, BANKERS).getUnbiased();
+    }
+    g_sink = sum;
+    printf("multiply by decimal(int)       %8.2f ns/op\n", elapsedNs(start, operations));
+
+    start = now();
+    sum = 0;
+    for (size_t i = 0; i < operations; i++)
+        sum += decimal::multiply(price, static_cast<int64>(i & 1023), 2, BANKERS).getUnbiased();
+    g_sink = sum;
+    printf("multiply by int64              %8.2f ns/op\n", elapsedNs(start, operations));
+
+    start = now();
+    sum = 0;
+    for (size_t i = 0; i < operations; i++)
+    {
+        decimal divisor(static_cast<int>(i & 1023) + 1, 2);
+        sum += decimal::divide(price, divisor, 4, BANKERS).getUnbiased();
+    }
+    g_sink = sum;
+    printf("divide by decimal(int)         %8.2f ns/op\n", elapsedNs(start, operations));
+
+    start = now();
+    sum = 0;
+    for (size_t i = 0; i < operations; i++)
+        sum += decimal::divide(price, static_cast<int64>(i & 1023) + 1, 4, BANKERS).getUnbiased();
+    g_sink = sum;
+    printf("divide by int64                %8.2f ns/op\n", elapsedNs(start, operations));
+
+    decimal basisPoint(0, 4);
+    basisPoint.setUnbiased(1);
+    start = now();
+    sum = 0;
+    for (size_t i = 0; i < operations; i++)
+    {
+        price.setUnbiased(1234567 + static_cast<int64>(i & 1023));
+        sum += decimal::multiply(price, basisPoint, 6, BANKERS).getUnbiased();
+    }
+    g_sink = sum;
+    printf("multiply by 0.0001             %8.2f ns/op\n", elapsedNs(start, operations));
+
+    start = now();
+    sum = 0;
+    for (size_t i = 0; i < operations; i++)
+    {
+        price.setUnbiased(1234567 + static_cast<int64>(i & 1023));
+        sum += decimal::shiftDecimal(price, -4, 6, BANKERS).getUnbiased();
+    }
+    g_sink = sum;
+    printf("shiftDecimal(-4)               %8.2f ns/op\n", elapsedNs(start, operations));
+}
+
+static void benchEvaluator()
+{
+    const size_t rows = 10000000;
+    std::vector<int64> qty(rows), price(rows), fx(rows), fee(rows), result(rows);
+    for (size_t i = 0; i < rows; i++)
+    {
+        qty[i] = static_cast<int64>(i % 1000) + 1;
+        price[i] = 1234567 + static_cast<int64>(i % 5000);
+        fx[i] = 108520000 + static_cast<int64>(i % 7);
+        fee[i] = 150 + static_cast<int64>(i % 11);
+    }
+
+    // per-row decimal method calls on one thread, exact int64 scalar paths with one
+    // final rounding (decimal * decimal with 8-digit fx would overflow int64)
+    std::vector<int64> expected(rows);
+    time_point start = now();
+    for (size_t i = 0; i < rows; i++)
+    {
+        decimal value(0, 4), rowFee(0, 2);
+        value.setUnbiased(price[i]);
+        rowFee.setUnbiased(fee[i]);
+        value.multiply(qty[i], 4, BANKERS);
+        value.multiply(fx[i], 4, BANKERS);
+        value.shiftDecimal(-8, 2, BANKERS);
+        value.subtract(rowFee, 2, BANKERS);
+        expected[i] = value.getUnbiased();
+    }
+    g_sink = expected[rows / 2];
+    printf("per-row decimal formula        %8.2f ns/row\n", elapsedNs(start, rows));
+
+    decimal_expression formula = column("qty") * column("price") * column("fx") - column("fee");
+    size_t maxThreads = std::thread::hardware_concurrency();
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        work_stealing_pool pool(threads);
+        columnar_evaluator evaluator(pool);
+        evaluator.bind("qty", &qty[0], 0);
+        evaluator.bind("price", &price[0], 4);
+        evaluator.bind("fx", &fx[0], 8);
+        evaluator.bind("fee", &fee[0], 2);
+
+        start = now();
+        evaluator.evaluate(formula, rows, 2, BANKERS, &result[0]);
+        g_sink = result[rows / 2];
+        double elapsed = elapsedNs(start, rows);
+        size_t mismatches = 0;
+        for (size_t i = 0; i < rows; i++)
+            if (result[i] != expected[i])
+                mismatches++;
+        printf("columnar_evaluator %2u threads  %8.2f ns/row (%u mismatches)\n", static_cast<unsigned>(threads),
+               elapsed, static_cast<unsigned>(mismatches));
+    }
+}
+
+int main()
+{
+    benchHash();
+    benchLadder();
+    benchScalar();
+    benchEvaluator();
+    return 0;
+}
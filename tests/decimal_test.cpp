@@ -6,6 +6,14 @@
  */
  
 #include "Decimal.h"
+#include "decimal_arrow.h"
+#include "decimal_window.h"
+#include "decimal_ladder.h"
+#include "decimal_stats.h"
+#ifdef DEC_HAS_CPP11
+#include "decimal_fx.h"
+#include "decimal_eval.h"
+#endif
 #include <cstdio>
 #include <iostream>
 #include <iomanip>
@@ -241,5 +249,703 @@ BOOST_AUTO_TEST_CASE( Testing_string_2 ) {
 	BOOST_CHECK_EQUAL( b.getAsDouble(),1.234);
 }	
 
+//ALLOCATE ---> shares sum up to total
+BOOST_AUTO_TEST_CASE( allocate_test_1 ) {
+
+	decimal total(100, 2);
+	int64 weights[3] = { 1, 1, 1 };
+	decimal shares[3];
+
+	allocate(total, weights, 3, shares);
+
+	BOOST_CHECK_EQUAL( shares[0].toString(), "33.34" );
+	BOOST_CHECK_EQUAL( shares[1].toString(), "33.33" );
+	BOOST_CHECK_EQUAL( shares[2].toString(), "33.33" );
+}
+
+//ALLOCATE ---> decimal weights, negative total
+BOOST_AUTO_TEST_CASE( allocate_test_2 ) {
+
+	decimal total(-10.01, 2, BANKERS);
+	decimal weights[4] = { decimal(0.5, 1, BANKERS), decimal(0.25, 2, BANKERS),
+	                       decimal(0.25, 2, BANKERS), decimal(0, 0) };
+	decimal shares[4];
+
+	allocate(total, weights, 4, shares);
+
+	BOOST_CHECK_EQUAL( shares[0].getUnbiased(), -501 );
+	BOOST_CHECK_EQUAL( shares[1].getUnbiased(), -250 );
+	BOOST_CHECK_EQUAL( shares[2].getUnbiased(), -250 );
+	BOOST_CHECK_EQUAL( shares[3].getUnbiased(), 0 );
+	BOOST_CHECK( decimal::add(decimal::add(shares[0], shares[1], 2, BANKERS),
+	                          decimal::add(shares[2], shares[3], 2, BANKERS), 2, BANKERS) == total );
+}
+
+//ALLOCATE ---> invalid weights
+BOOST_AUTO_TEST_CASE( allocate_test_3 ) {
+
+	decimal total(1, 2);
+	int64 weights[2] = { 0, 0 };
+	decimal shares[2];
+
+	BOOST_CHECK_THROW( allocate(total, weights, 2, shares), const char * );
+
+	// 1e12 rescaled to precision 8 does not fit in int64
+	decimal mixed[2] = { decimal(0, 0), decimal(0, 8) };
+	mixed[0].setUnbiased(1000000000000LL);
+	mixed[1].setUnbiased(1);
+	BOOST_CHECK_THROW( allocate(total, mixed, 2, shares), const char * );
+}
+
+//HASH ---> equal values hash equal across precisions
+BOOST_AUTO_TEST_CASE( hash_test_1 ) {
+
+	decimal a(0, 1);
+	decimal b(0, 2);
+	a.setUnbiased(15);
+	b.setUnbiased(150);
+	decimal c(-2.5, 1, BANKERS);
+	decimal d(-2.500, 3, BANKERS);
+	decimal zero1(0, 0);
+	decimal zero2(0, 6);
+
+	BOOST_CHECK( a == b );
+	BOOST_CHECK_EQUAL( a.hash(), b.hash() );
+	BOOST_CHECK_EQUAL( c.hash(), d.hash() );
+	BOOST_CHECK_EQUAL( zero1.hash(), zero2.hash() );
+	BOOST_CHECK( a.hash() != c.hash() );
+	BOOST_CHECK_EQUAL( decimal_hash()(a), b.hash() );
+#ifdef DEC_HAS_CPP11
+	BOOST_CHECK_EQUAL( std::hash<decimal>()(d), c.hash() );
+#endif
+}
+
+//ACCUMULATE ---> single rounding at the end
+BOOST_AUTO_TEST_CASE( accumulator_test_1 ) {
+
+	decimal_accumulator total;
+	decimal third(0, 4);
+	third.setUnbiased(3333);
+
+	for (int i = 0; i < 3; i++)
+		total.add(third);
+	total.add(decimal(0.00015, 5, BANKERS));
+
+	BOOST_CHECK_EQUAL( total.getPrecision(), 5 );
+	BOOST_CHECK_EQUAL( total.getValue(2, BANKERS).toString(), "1.00" );
+	BOOST_CHECK_EQUAL( total.getValue(4, BANKERS).getUnbiased(), 10000 );
+	BOOST_CHECK_EQUAL( total.getValue(6, BANKERS).getUnbiased(), 1000050 );
+}
+
+//ACCUMULATE ---> banker's rounding of negative values, order independence
+BOOST_AUTO_TEST_CASE( accumulator_test_2 ) {
+
+	decimal_accumulator forward, backward;
+	decimal values[3] = { decimal(-1.125, 3, BANKERS), decimal(2, 0), decimal(-3.5, 1, BANKERS) };
+
+	for (int i = 0; i < 3; i++)
+		forward.add(values[i]);
+	for (int i = 2; i >= 0; i--)
+		backward.add(values[i]);
+	forward.subtract(decimal(1, 0));
+	backward.subtract(decimal(1, 0));
+
+	BOOST_CHECK_EQUAL( forward.getValue(2, BANKERS).getUnbiased(), -362 );
+	BOOST_CHECK( forward.getValue(3, BANKERS) == backward.getValue(3, BANKERS) );
+}
+
+//ACCUMULATOR ---> overflow of widened sum throws
+BOOST_AUTO_TEST_CASE( accumulator_test_3 ) {
+
+	decimal tiny(0, 18), huge(0, 0);
+	tiny.setUnbiased(1);
+	huge.setUnbiased(INT64_MAX_VALUE);
+
+	decimal_accumulator sum, difference;
+	sum.add(tiny);
+	difference.add(tiny);
+	for (int i = 0; i < 18; i++)
+	{
+		sum.add(huge);
+		difference.subtract(huge);
+	}
+	BOOST_CHECK_THROW( sum.add(huge), const char * );
+	BOOST_CHECK_THROW( difference.subtract(huge), const char * );
+
+	decimal_accumulator merged;
+	merged.add(sum);
+	BOOST_CHECK_THROW( merged.add(sum), const char * );
+}
+
+//CONVERSION ---> double to decimal rounds exact binary value
+BOOST_AUTO_TEST_CASE( conversion_test_1 ) {
+
+	BOOST_CHECK_EQUAL( decimal(2.675, 2, BANKERS).getUnbiased(), 267 );
+	BOOST_CHECK_EQUAL( decimal(0.125, 2, BANKERS).getUnbiased(), 12 );
+	BOOST_CHECK_EQUAL( decimal(-0.375, 2, BANKERS).getUnbiased(), -38 );
+	BOOST_CHECK_EQUAL( decimal(1e-300, 6, BANKERS).getUnbiased(), 0 );
+	BOOST_CHECK_EQUAL( decimal(1e15, 3, BANKERS).getUnbiased(), 1000000000000000000LL );
+	BOOST_CHECK_THROW( decimal(1e16, 3, BANKERS), const char * );
+
+	// decimal literal semantics: shortest form first, then round
+	decimal literal = shortestDecimal(2.675, 6, BANKERS);
+	BOOST_CHECK_EQUAL( literal.getUnbiased(), 2675 );
+	BOOST_CHECK_EQUAL( decimal::add(literal, decimal(0, 2), 2, BANKERS).getUnbiased(), 268 );
+}
+
+//CONVERSION ---> decimal to double, shortest decimal
+BOOST_AUTO_TEST_CASE( conversion_test_2 ) {
+
+	decimal big(0, 2);
+	big.setUnbiased(1234567890123456789LL);
+
+	BOOST_CHECK_EQUAL( big.getAsDouble(), 12345678901234567.89 );
+	BOOST_CHECK_EQUAL( shortestDecimal(0.1, 6, BANKERS).getPrecision(), 1 );
+	BOOST_CHECK_EQUAL( shortestDecimal(2.675, 6, BANKERS).toString(), "2.675" );
+	BOOST_CHECK_EQUAL( shortestDecimal(1.0 / 3.0, 6, BANKERS).getUnbiased(), 333333 );
+}
+
+//CONVERSION ---> batch kernels
+BOOST_AUTO_TEST_CASE( conversion_test_3 ) {
+
+	double values[3] = { 1.5, -0.01, 35.555 };
+	decimal decimals[3];
+	double back[3];
+	int64 unbiased[3];
+
+	fromDoubles(values, 3, 2, BANKERS, decimals);
+	toDoubles(decimals, 3, back);
+	doublesToUnbiased(values, 3, 3, BANKERS, unbiased);
+
+	BOOST_CHECK_EQUAL( decimals[2].toString(), "35.55" );
+	BOOST_CHECK_EQUAL( back[0], 1.5 );
+	BOOST_CHECK_EQUAL( back[1], -0.01 );
+	BOOST_CHECK_EQUAL( unbiased[2], 35555 );
+
+	unbiasedToDoubles(unbiased, 3, 3, back);
+	BOOST_CHECK_EQUAL( back[2], 35.555 );
+}
+
+//ARROW ---> Decimal128 round trip with validity bitmap
+BOOST_AUTO_TEST_CASE( arrow_test_1 ) {
+
+	decimal values[3] = { decimal(1.5, 1, BANKERS), decimal(-2.25, 2, BANKERS), decimal(7, 0) };
+	arrow_decimal_field field = arrow_decimal_field::decimal128(10, 2);
+	unsigned char data[48];
+	unsigned char validity[1] = { 0 };
+
+	exportArrowDecimal(values, 3, field, BANKERS, data, validity);
+
+	BOOST_CHECK_EQUAL( validity[0], 7 );
+	BOOST_CHECK_EQUAL( data[0], 150 );
+	BOOST_CHECK_EQUAL( data[16], 0x1F );
+	BOOST_CHECK_EQUAL( data[31], 0xFF );
+
+	setArrowBit(validity, 1, false);
+	decimal imported[2];
+	bool isValid[2];
+	importArrowDecimal(data, validity, 1, 2, field, imported, isValid);
+
+	BOOST_CHECK( !isValid[0] );
+	BOOST_CHECK( isValid[1] );
+	BOOST_CHECK_EQUAL( imported[0].getUnbiased(), 0 );
+	BOOST_CHECK_EQUAL( imported[1].toString(), "7.00" );
+}
+
+//ARROW ---> Decimal64 view, precision overflow
+BOOST_AUTO_TEST_CASE( arrow_test_2 ) {
+
+	int64 unbiased[2] = { 12345, -99999 };
+	arrow_decimal_field field = arrow_decimal_field::decimal64(5, 3);
+	unsigned char data[16];
+
+	exportArrowDecimal(unbiased, 2, field, data);
+	arrow_decimal_view view(data, NULL, 0, 2, field);
+
+	BOOST_CHECK_EQUAL( view.get(0).toString(), "12.345" );
+	BOOST_CHECK_EQUAL( view.getUnbiased(1), -99999 );
+
+	decimal tooLarge(100, 0);
+	BOOST_CHECK_THROW( exportArrowDecimal(&tooLarge, 1, field, BANKERS, data, NULL), const char * );
+
+	int64 tooLong[2] = { 1, 100000 };
+	BOOST_CHECK_THROW( exportArrowDecimal(tooLong, 2, field, data), const char * );
+	arrow_decimal_field wide = arrow_decimal_field::decimal128(5, 3);
+	unsigned char wideData[32];
+	BOOST_CHECK_THROW( exportArrowDecimal(tooLong, 2, wide, wideData), const char * );
+}
+
+//WINDOW ---> count based sum, mean, min, max
+BOOST_AUTO_TEST_CASE( window_test_1 ) {
+
+	rolling_window window(3, 0, 2, 0);
+	double prices[5] = { 10.00, 12.50, 9.75, 11.00, 10.10 };
+
+	for (int i = 0; i < 5; i++)
+		window.push(decimal(prices[i], 2, BANKERS));
+
+	BOOST_CHECK_EQUAL( window.getCount(), 3u );
+	BOOST_CHECK_EQUAL( window.getSum(2, BANKERS).toString(), "30.85" );
+	BOOST_CHECK_EQUAL( window.getMean(2, BANKERS).toString(), "10.28" );
+	BOOST_CHECK_EQUAL( window.getMean(4, BANKERS).toString(), "10.2833" );
+	BOOST_CHECK_EQUAL( window.getMin().toString(), "9.75" );
+	BOOST_CHECK_EQUAL( window.getMax().toString(), "11.00" );
+
+	window.push(decimal(10.50, 2, BANKERS));
+	BOOST_CHECK_EQUAL( window.getMin().toString(), "10.10" );
+}
+
+//WINDOW ---> time based VWAP
+BOOST_AUTO_TEST_CASE( window_test_2 ) {
+
+	rolling_window window(0, 60, 2, 0);
+
+	window.push(decimal(100, 2), decimal(10, 0), 0);
+	window.push(decimal(101, 2), decimal(30, 0), 30);
+	BOOST_CHECK_EQUAL( window.getVwap(2, BANKERS).toString(), "100.75" );
+
+	window.push(decimal(102, 2), decimal(10, 0), 70);
+	BOOST_CHECK_EQUAL( window.getCount(), 2u );
+	BOOST_CHECK_EQUAL( window.getVwap(2, BANKERS).toString(), "101.25" );
+
+	window.expire(200);
+	BOOST_CHECK( window.isEmpty() );
+	BOOST_CHECK_THROW( window.getVwap(2, BANKERS), const char * );
+}
+
+//WINDOW ---> 8-digit prices and quantities read with 2 digits
+BOOST_AUTO_TEST_CASE( window_test_3 ) {
+
+	rolling_window window(1000, 0, 8, 8);
+	decimal price(0, 8), quantity(0, 8);
+	price.setUnbiased(2500000000000LL);
+	quantity.setUnbiased(100000000000LL);
+
+	for (int i = 0; i < 1000; i++)
+		window.push(price, quantity);
+
+	BOOST_CHECK_EQUAL( window.getVwap(2, BANKERS).getUnbiased(), 2500000 );
+	BOOST_CHECK_EQUAL( window.getMean(2, BANKERS).getUnbiased(), 2500000 );
+	BOOST_CHECK_EQUAL( window.getVwap(12, BANKERS).getUnbiased(), 25000000000000000LL );
+}
+
+//WINDOW ---> notional overflow throws and leaves window unchanged
+BOOST_AUTO_TEST_CASE( window_test_4 ) {
+
+	rolling_window window(0, 0, 0, 0);
+	decimal huge(0, 0);
+	huge.setUnbiased(INT64_MAX_VALUE);
+
+	window.push(huge, huge);
+	window.push(huge, huge);
+	BOOST_CHECK_THROW( window.push(huge, huge), const char * );
+	BOOST_CHECK_EQUAL( window.getCount(), 2u );
+	BOOST_CHECK( window.getVwap(0, BANKERS) == huge );
+}
+
+//LADDER ---> best levels and iteration across dense and sparse storage
+BOOST_AUTO_TEST_CASE( ladder_test_1 ) {
+
+	price_ladder<int64> book(decimal(0.05, 2, BANKERS), 2, 100, decimal(100, 2));
+	decimal price;
+
+	BOOST_CHECK( !book.getLowest(price) );
+
+	book[decimal(100.05, 2, BANKERS)] = 10;
+	book[decimal(99.9, 1, BANKERS)] = 20;
+	book[decimal(150, 0)] = 30;
+	book[decimal(50, 0)] = 40;
+
+	BOOST_CHECK_EQUAL( book.size(), 4u );
+	BOOST_CHECK( book.getLowest(price) );
+	BOOST_CHECK_EQUAL( price.toString(), "50.00" );
+	BOOST_CHECK( book.getHighest(price) );
+	BOOST_CHECK_EQUAL( price.toString(), "150.00" );
+
+	BOOST_CHECK( book.getNextAbove(decimal(50, 0), price) );
+	BOOST_CHECK_EQUAL( price.toString(), "99.90" );
+	BOOST_CHECK( book.getNextAbove(price, price) );
+	BOOST_CHECK_EQUAL( price.toString(), "100.05" );
+	BOOST_CHECK( book.getNextBelow(decimal(150, 0), price) );
+	BOOST_CHECK_EQUAL( price.toString(), "100.05" );
+
+	BOOST_CHECK( book.erase(decimal(150, 0)) );
+	BOOST_CHECK( book.erase(decimal(100.05, 2, BANKERS)) );
+	BOOST_CHECK( book.getHighest(price) );
+	BOOST_CHECK_EQUAL( price.toString(), "99.90" );
+	BOOST_CHECK_THROW( book[decimal(100.01, 2, BANKERS)], const char * );
+}
+
+//LADDER ---> recentering keeps levels
+BOOST_AUTO_TEST_CASE( ladder_test_2 ) {
+
+	price_ladder<int64> book(decimal(1, 0), 0, 64, decimal(100, 0));
+	for (int i = 90; i <= 110; i += 5)
+		book[decimal(i, 0)] = i;
+	book[decimal(500, 0)] = 500;
+
+	book.recenter(decimal(480, 0));
+
+	BOOST_CHECK_EQUAL( book.size(), 6u );
+	BOOST_CHECK_EQUAL( book.getFirstDenseTick(), 448 );
+	BOOST_CHECK_EQUAL( *book.find(decimal(500, 0)), 500 );
+	BOOST_CHECK_EQUAL( *book.find(decimal(95, 0)), 95 );
+
+	decimal price;
+	BOOST_CHECK( book.getNextBelow(decimal(500, 0), price) );
+	BOOST_CHECK_EQUAL( price.toString(), "110" );
+}
+
+//SCALAR ---> integer fast paths
+BOOST_AUTO_TEST_CASE( scalar_test_1 ) {
+
+	decimal price(12.345, 3, BANKERS);
+	int64 quantity = 1000000000LL;
+
+	BOOST_CHECK_EQUAL( decimal::multiply(price, quantity, 2, BANKERS).getUnbiased(), 1234500000000LL );
+	BOOST_CHECK_EQUAL( decimal::multiply(price, 3, 2, BANKERS).toString(), "37.04" );
+	BOOST_CHECK_EQUAL( decimal::divide(price, static_cast<int64>(-4), 3, BANKERS).getUnbiased(), -3086 );
+	BOOST_CHECK_EQUAL( decimal::divide(price, static_cast<int64>(3), 5, BANKERS).getUnbiased(), 411500 );
+
+	decimal total(10.25, 2, BANKERS);
+	total.add(5, 1, BANKERS);
+	BOOST_CHECK_EQUAL( total.toString(), "15.2" );
+	total.subtract(static_cast<int64>(20), 2, BANKERS);
+	BOOST_CHECK_EQUAL( total.getUnbiased(), -480 );
+	BOOST_CHECK_THROW( total.divide(static_cast<int64>(0), 2, BANKERS), const char * );
+}
+
+//SCALAR ---> power of ten shifts
+BOOST_AUTO_TEST_CASE( scalar_test_2 ) {
+
+	decimal amount(1234.5, 1, BANKERS);
+
+	BOOST_CHECK_EQUAL( decimal::shiftDecimal(amount, -4, 4, BANKERS).getUnbiased(), 1234 );
+	BOOST_CHECK_EQUAL( decimal::shiftDecimal(amount, -2, 2, BANKERS).toString(), "12.34" );
+	BOOST_CHECK_EQUAL( decimal::shiftDecimal(amount, 3, 0, BANKERS).getUnbiased(), 1234500 );
+
+	amount.shiftDecimal(-1, 1, BANKERS);
+	BOOST_CHECK_EQUAL( amount.toString(), "123.4" );
+}
+
+//SCALAR ---> precisions above 9, most negative value
+BOOST_AUTO_TEST_CASE( scalar_test_3 ) {
+
+	BOOST_CHECK_EQUAL( decimal(25000, 12).getUnbiased(), 25000000000000000LL );
+	BOOST_CHECK( decimal(3, 18) == decimal(3, 0) );
+	BOOST_CHECK( decimal(1, 10) < decimal(2, 17) );
+
+	decimal lowest(0, 0);
+	lowest.setUnbiased(-INT64_MAX_VALUE - 1);
+	BOOST_CHECK_EQUAL( decimal::divide(lowest, static_cast<int64>(-2), 0, BANKERS).getUnbiased(), 4611686018427387904LL );
+	BOOST_CHECK_THROW( decimal::divide(lowest, static_cast<int64>(-1), 0, BANKERS), const char * );
+}
+
+//STATS ---> correctly rounded square root
+BOOST_AUTO_TEST_CASE( sqrt_test_1 ) {
+
+	BOOST_CHECK_EQUAL( decimal(2, 0).sqrt(6, BANKERS).getUnbiased(), 1414214 );
+	BOOST_CHECK_EQUAL( decimal(0.25, 2, BANKERS).sqrt(0, BANKERS).getUnbiased(), 0 );
+	BOOST_CHECK_EQUAL( decimal(2.25, 2, BANKERS).sqrt(0, BANKERS).getUnbiased(), 2 );
+	BOOST_CHECK_EQUAL( decimal(6.25, 2, BANKERS).sqrt(0, BANKERS).getUnbiased(), 2 );
+	BOOST_CHECK_EQUAL( decimal(12.25, 2, BANKERS).sqrt(0, BANKERS).getUnbiased(), 4 );
+	BOOST_CHECK_EQUAL( decimal(144, 4).sqrt(2, BANKERS).toString(), "12.00" );
+	BOOST_CHECK_THROW( decimal(-1, 0).sqrt(2, BANKERS), const char * );
+}
+
+//STATS ---> variance and standard deviation, merged partial results
+BOOST_AUTO_TEST_CASE( stats_test_1 ) {
+
+	decimal values[8] = { decimal(2, 0), decimal(4, 0), decimal(4, 0), decimal(4, 0),
+	                      decimal(5, 0), decimal(5, 0), decimal(7, 0), decimal(9.0, 1, BANKERS) };
+
+	decimal_moments moments = computeMoments(values, 8);
+
+	BOOST_CHECK_EQUAL( moments.getMean(2, BANKERS).toString(), "5.00" );
+	BOOST_CHECK_EQUAL( moments.getVariance(2, BANKERS, false).toString(), "4.00" );
+	BOOST_CHECK_EQUAL( moments.getStandardDeviation(3, BANKERS, false).toString(), "2.000" );
+	BOOST_CHECK_EQUAL( variance(values, 8, 4, BANKERS, true).toString(), "4.5714" );
+	BOOST_CHECK_EQUAL( standardDeviation(values, 8, 4, BANKERS, true).toString(), "2.1381" );
+
+	decimal_moments first = computeMoments(values, 3);
+	decimal_moments second = computeMoments(values + 3, 5);
+	decimal_moments firstScaled(1);
+	for (int i = 0; i < 3; i++)
+		firstScaled.add(values[i]);
+	firstScaled.merge(second);
+
+	BOOST_CHECK_THROW( first.merge(second), const char * );
+	BOOST_CHECK_EQUAL( firstScaled.getCount(), 8u );
+	BOOST_CHECK( firstScaled.getVariance(6, BANKERS, true) == moments.getVariance(6, BANKERS, true) );
+}
+
+//STATS ---> large clustered values stay exact, overflow throws
+BOOST_AUTO_TEST_CASE( stats_test_2 ) {
+
+	// 8-digit prices around 25000, sum of squares would need about 2 ^ 115
+	decimal_moments moments(8);
+	decimal_moments half(8);
+	for (int i = 0; i < 10000; i++)
+	{
+		int64 value = 2500000000000LL + (i % 2 == 0 ? -100000000LL : 100000000LL);
+		moments.addUnbiased(value);
+		if (i >= 5000)
+			half.addUnbiased(value + 1);
+	}
+	BOOST_CHECK_EQUAL( moments.getMean(2, BANKERS).getUnbiased(), 2500000 );
+	BOOST_CHECK_EQUAL( moments.getVariance(2, BANKERS, false).getUnbiased(), 100 );
+	BOOST_CHECK_EQUAL( moments.getStandardDeviation(8, BANKERS, false).getUnbiased(), 100000000 );
+
+	moments.merge(half);
+	BOOST_CHECK_EQUAL( moments.getCount(), 15000u );
+	BOOST_CHECK_EQUAL( moments.getMean(8, BANKERS).getUnbiased(), 2500000000000LL );
+
+	// squared deviations of 8e18 no longer fit in 128 bits
+	decimal_moments wide(0);
+	for (int i = 0; i < 5; i++)
+		wide.addUnbiased(i % 2 == 0 ? -4000000000000000000LL : 4000000000000000000LL);
+	BOOST_CHECK_THROW( wide.addUnbiased(4000000000000000000LL), const char * );
+}
+
+#ifdef DEC_HAS_CPP11
+//FX ---> quoted, reciprocal and cross rates
+BOOST_AUTO_TEST_CASE( fx_test_1 ) {
+
+	fx_rate_matrix rates(8);
+	size_t usd = rates.addCurrency("USD");
+	size_t eur = rates.addCurrency("EUR");
+	size_t jpy = rates.addCurrency("JPY");
+
+	rates.setRate(eur, usd, decimal(1.2500, 4, BANKERS));
+	rates.setRate(usd, jpy, decimal(150.25, 2, BANKERS));
+	fx_rate_matrix::snapshot_ptr snapshot = rates.publish();
+
+	BOOST_CHECK_EQUAL( snapshot->getRate(eur, usd).toString(), "1.25" );
+	BOOST_CHECK_EQUAL( snapshot->getRate(usd, eur).getUnbiased(), 8 );
+	BOOST_CHECK_EQUAL( snapshot->getRate(usd, eur).getPrecision(), 1 );
+	BOOST_CHECK_EQUAL( snapshot->getRate(eur, jpy).toString(), "187.8125" );
+	BOOST_CHECK_EQUAL( snapshot->getRate(jpy, usd).getUnbiased(), 6655574 );
+	BOOST_CHECK_EQUAL( snapshot->getRate(jpy, usd).getPrecision(), 9 );
+	BOOST_CHECK_EQUAL( snapshot->getCurrency("JPY"), jpy );
+
+	BOOST_CHECK_EQUAL( snapshot->convert(decimal(100.01, 2, BANKERS), eur, usd, 2, BANKERS).toString(), "125.01" );
+	BOOST_CHECK_EQUAL( snapshot->convert(decimal(3, 0), usd, jpy, 0, BANKERS).getUnbiased(), 451 );
+}
+
+//FX ---> batch conversion and versioned snapshots
+BOOST_AUTO_TEST_CASE( fx_test_2 ) {
+
+	fx_rate_matrix rates(6);
+	size_t usd = rates.addCurrency("USD");
+	size_t gbp = rates.addCurrency("GBP");
+	rates.setRate(gbp, usd, decimal(1.3, 1, BANKERS));
+	fx_rate_matrix::snapshot_ptr first = rates.publish();
+
+	rates.setRate(gbp, usd, decimal(1.4, 1, BANKERS));
+	rates.publish();
+	fx_rate_matrix::snapshot_ptr second = rates.getSnapshot();
+
+	int64 amounts[3] = { 1000, -255, 1 };
+	int64 converted[3];
+	first->convert(amounts, 3, 2, gbp, usd, 2, BANKERS, converted);
+
+	BOOST_CHECK( second->getVersion() > first->getVersion() );
+	BOOST_CHECK_EQUAL( converted[0], 1300 );
+	BOOST_CHECK_EQUAL( converted[1], -332 );
+	BOOST_CHECK_EQUAL( converted[2], 1 );
+	BOOST_CHECK_EQUAL( second->getRate(gbp, usd).toString(), "1.4" );
+	BOOST_CHECK_THROW( second->getRate(gbp, 5), const char * );
+	// "to" out of range while flat index is still inside the matrix
+	BOOST_CHECK_THROW( second->hasRate(usd, 3), const char * );
+	BOOST_CHECK_THROW( second->getRate(usd, 3), const char * );
+}
+
+//FX ---> derived rates keep significant digits, rates rounding to zero, scaled rate overflow
+BOOST_AUTO_TEST_CASE( fx_test_3 ) {
+
+	fx_rate_matrix rates(2);
+	size_t usd = rates.addCurrency("USD");
+	size_t idr = rates.addCurrency("IDR");
+	size_t big = rates.addCurrency("BIG");
+	rates.setRate(usd, idr, decimal(16000, 0));
+	decimal bigRate(0, 0);
+	bigRate.setUnbiased(5000000000000000000LL);
+	rates.setRate(usd, big, bigRate);
+	fx_rate_matrix::snapshot_ptr snapshot = rates.publish();
+
+	// 1 / 16000 = 0.0000625 with 2 significant digits
+	BOOST_CHECK_EQUAL( snapshot->getRate(idr, usd).getUnbiased(), 62 );
+	BOOST_CHECK_EQUAL( snapshot->getRate(idr, usd).getPrecision(), 6 );
+
+	// 1 / 5e18 is below 10 ^ -18
+	BOOST_CHECK( !snapshot->hasRate(big, usd) );
+	BOOST_CHECK_THROW( snapshot->convert(decimal(1, 0), big, usd, 2, BANKERS), const char * );
+
+	int64 amount = 1;
+	int64 converted;
+	BOOST_CHECK_THROW( snapshot->convert(&amount, 1, 0, usd, big, 2, BANKERS, &converted), const char * );
+}
+
+//FX ---> cross rate from two reciprocals is rounded once, invalid quotes are rejected
+BOOST_AUTO_TEST_CASE( fx_test_4 ) {
+
+	fx_rate_matrix rates(8);
+	size_t usd = rates.addCurrency("USD");
+	size_t idr = rates.addCurrency("IDR");
+	size_t jpy = rates.addCurrency("JPY");
+	rates.setRate(usd, idr, decimal(16123.45, 2, BANKERS));
+	rates.setRate(usd, jpy, decimal(150.25, 2, BANKERS));
+
+	BOOST_CHECK_THROW( rates.setRate(7, usd, decimal(1, 0)), const char * );
+	BOOST_CHECK_THROW( rates.setRate(usd, usd, decimal(1, 0)), const char * );
+	BOOST_CHECK_THROW( rates.setBaseCurrency(3), const char * );
+	fx_rate_matrix::snapshot_ptr snapshot = rates.publish();
+
+	// 1 / 16123.45 = 0.000062021466 (8 significant digits)
+	int64 amount = 10000000000LL;
+	int64 converted;
+	snapshot->convert(&amount, 1, 0, idr, usd, 2, BANKERS, &converted);
+	BOOST_CHECK_EQUAL( converted, 62021466LL );
+	// 150.25 / 16123.45 = 0.0093187252
+	BOOST_CHECK_EQUAL( snapshot->getRate(idr, jpy).getUnbiased(), 93187252 );
+	BOOST_CHECK_EQUAL( snapshot->getRate(idr, jpy).getPrecision(), 10 );
+	BOOST_CHECK_THROW( fx_rate_matrix(0), const char * );
+}
+
+//EVAL ---> formula over columns, single rounding
+BOOST_AUTO_TEST_CASE( eval_test_1 ) {
+
+	const size_t rows = 10000;
+	std::vector<int64> qty(rows), price(rows), fx(rows), fee(rows), result(rows);
+	for (size_t i = 0; i < rows; i++)
+	{
+		qty[i] = static_cast<int64>(i % 100) + 1;
+		price[i] = 123456 + static_cast<int64>(i);
+		fx[i] = 108520000;
+		fee[i] = 150;
+	}
+
+	work_stealing_pool pool(4);
+	columnar_evaluator evaluator(pool, 256);
+	evaluator.bind("qty", &qty[0], 0);
+	evaluator.bind("price", &price[0], 4);
+	evaluator.bind("fx", &fx[0], 8);
+	evaluator.bind("fee", &fee[0], 2);
+
+	decimal_expression formula = column("qty") * column("price") * column("fx") - column("fee");
+	evaluator.evaluate(formula, rows, 2, BANKERS, &result[0]);
+
+	for (size_t i = 0; i < rows; i += 997)
+	{
+		decimal expected = decimal::multiply(decimal::multiply(decimal(qty[i], 0), price[i] / 10000.0, 6, BANKERS),
+		                                     decimal(1.0852, 4, BANKERS), 2, BANKERS);
+		expected.subtract(decimal(1.5, 1, BANKERS), 2, BANKERS);
+		BOOST_CHECK_EQUAL( result[i], expected.getUnbiased() );
+	}
+	BOOST_CHECK_EQUAL( result[0], 1190 );
+}
+
+//EVAL ---> constants, negation and errors from worker threads
+BOOST_AUTO_TEST_CASE( eval_test_2 ) {
+
+	int64 values[3] = { 100, -250, 5 };
+	int64 result[3];
+
+	work_stealing_pool pool(2);
+	columnar_evaluator evaluator(pool, 1);
+	evaluator.bind("x", values, 2);
+
+	evaluator.evaluate(-(column("x") + constant(decimal(0.5, 1, BANKERS))), 3, 1, BANKERS, result);
+	BOOST_CHECK_EQUAL( result[0], -15 );
+	BOOST_CHECK_EQUAL( result[1], 20 );
+	BOOST_CHECK_EQUAL( result[2], -6 );
+
+	BOOST_CHECK_THROW( evaluator.evaluate(column("y"), 3, 1, BANKERS, result), const char * );
+
+	int64 huge[1] = { INT64_MAX_VALUE };
+	evaluator.bind("huge", huge, 0);
+	BOOST_CHECK_THROW( evaluator.evaluate(column("huge") * column("huge") * column("huge"), 1, 0, BANKERS, result),
+	                   const char * );
+}
+
+//EVAL ---> products above 18 digits are exact, result is rounded once
+BOOST_AUTO_TEST_CASE( eval_test_3 ) {
+
+	int64 qty[2] = { 10000, 10001 };
+	int64 price[2] = { 100000000, 100000001 };
+	int64 fx[2] = { 10000000000LL, 10000000001LL };
+	int64 result[2];
+
+	work_stealing_pool pool(2);
+	columnar_evaluator evaluator(pool);
+	evaluator.bind("qty", qty, 4);
+	evaluator.bind("price", price, 8);
+	evaluator.bind("fx", fx, 10);
+	decimal_expression formula = column("qty") * column("price") * column("fx");
+
+	evaluator.evaluate(formula, 2, 2, BANKERS, result);
+	BOOST_CHECK_EQUAL( result[0], 100 );
+	BOOST_CHECK_EQUAL( result[1], 100 );
+
+	// 1.0001 * 1.00000001 * 1.0000000001 = 1.0001000101010100010001
+	evaluator.evaluate(formula, 2, 18, BANKERS, result);
+	BOOST_CHECK_EQUAL( result[0], 1000000000000000000LL );
+	BOOST_CHECK_EQUAL( result[1], 1000100010101010001LL );
+
+	BOOST_CHECK_THROW( evaluator.evaluate(formula, 2, 19, BANKERS, result), const char * );
+
+	// 0.0000000003 * 0.0166666666666666667 = 0.00500000000000000001, above half a cent
+	int64 a[1] = { 3 };
+	int64 b[1] = { 166666666666666667LL };
+	int64 one[1] = { 1 };
+	evaluator.bind("a", a, 10);
+	evaluator.bind("b", b, 10);
+	evaluator.bind("one", one, 0);
+	evaluator.evaluate(column("a") * column("b"), 1, 2, BANKERS, result);
+	BOOST_CHECK_EQUAL( result[0], 1 );
+	evaluator.evaluate(column("a") * column("b") - column("one"), 1, 2, BANKERS, result);
+	BOOST_CHECK_EQUAL( result[0], -99 );
+
+	// 10 ^ -40 is below 128-bit divisor limit and rounds to zero
+	evaluator.evaluate(column("a") * column("a") * column("a") * column("a"), 1, 18, BANKERS, result);
+	BOOST_CHECK_EQUAL( result[0], 0 );
+
+	// products beyond 128 bits throw
+	int64 huge[1] = { INT64_MAX_VALUE };
+	evaluator.bind("huge", huge, 0);
+	BOOST_CHECK_THROW( evaluator.evaluate(column("huge") * column("huge") * column("huge"), 1, 0, BANKERS, result),
+	                   const char * );
+}
+
+//EVAL ---> concurrent callers sharing one pool
+BOOST_AUTO_TEST_CASE( eval_test_4 ) {
+
+	const size_t rows = 5000;
+	const size_t callers = 4;
+	std::vector<int64> values(rows);
+	for (size_t i = 0; i < rows; i++)
+		values[i] = static_cast<int64>(i);
+
+	work_stealing_pool pool(3);
+	columnar_evaluator evaluator(pool, 64);
+	evaluator.bind("x", &values[0], 0);
+
+	std::vector<std::vector<int64> > results(callers, std::vector<int64>(rows));
+	std::vector<std::thread> threads;
+	for (size_t c = 0; c < callers; c++)
+		threads.push_back(std::thread([&, c] {
+			for (int repeat = 0; repeat < 20; repeat++)
+				evaluator.evaluate(column("x") * constant(decimal(static_cast<int>(c) + 1, 0)), rows - c * 1000, 0,
+				                   BANKERS, &results[c][0]);
+		}));
+	for (size_t c = 0; c < callers; c++)
+		threads[c].join();
+
+	for (size_t c = 0; c < callers; c++)
+		for (size_t i = 0; i < rows - c * 1000; i += 101)
+			BOOST_CHECK_EQUAL( results[c][i], static_cast<int64>(i * (c + 1)) );
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
 